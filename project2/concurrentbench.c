@@ -0,0 +1,202 @@
+/** @file concurrentbench.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libpriqueue/libpriqueue.h"
+
+/*
+ * Throughput of a shared queue against the number of threads: the
+ * lock-free concurrent priqueue, the relaxed MultiQueue with two shards
+ * per thread, and one mutex around a list priqueue. The queue starts with
+ * PREFILL elements and every thread then does an even mix of offers and
+ * polls with random keys.
+ *
+ * The relaxed queue's rank error, how many smaller keys were queued when
+ * a key was polled, is then measured on the same workload for each shard
+ * count. It is run on one thread so every poll can be checked against an
+ * exact count; the error comes from the random shard choice, not from
+ * interleaving, so it matches what that many threads would see.
+ *
+ * Usage: concurrentbench [ops per thread]   (default 200000)
+ */
+
+#define PREFILL 1000
+#define MAX_THREADS 16
+#define MAX_KEY 100000
+
+enum { MUTEX, CONCURRENT, RELAXED };
+
+typedef struct _bench_t
+{
+	priqueue_t *q;
+	pthread_mutex_t *lock;	// NULL for the concurrent queues
+	int *keys;
+	int ops;
+} bench_t;
+
+int compare(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *worker(void *arg)
+{
+	bench_t *b = arg;
+	int i;
+
+	for (i = 0; i < b->ops; i++)
+	{
+		if (b->lock)
+			pthread_mutex_lock(b->lock);
+
+		if (i % 2 == 0)
+			priqueue_offer(b->q, &b->keys[i]);
+		else
+			priqueue_poll(b->q);
+
+		if (b->lock)
+			pthread_mutex_unlock(b->lock);
+	}
+
+	return NULL;
+}
+
+/* Returns millions of operations per second. */
+double run(int kind, int threads, int ops, int *keys)
+{
+	priqueue_t q;
+	pthread_mutex_t lock;
+	pthread_t tid[MAX_THREADS];
+	bench_t work[MAX_THREADS];
+	int i;
+
+	if (kind == CONCURRENT)
+		priqueue_concurrent_init(&q, compare);
+	else if (kind == RELAXED)
+		priqueue_concurrent_init_flags(&q, compare, PRIQUEUE_RELAXED | PRIQUEUE_SHARDS(2 * threads));
+	else
+		priqueue_init(&q, compare);
+	pthread_mutex_init(&lock, NULL);
+
+	for (i = 0; i < PREFILL; i++)
+		priqueue_offer(&q, &keys[i]);
+
+	for (i = 0; i < threads; i++)
+	{
+		work[i].q = &q;
+		work[i].lock = kind == MUTEX ? &lock : NULL;
+		work[i].keys = keys + PREFILL + i * ops;
+		work[i].ops = ops;
+	}
+
+	double start = now();
+	for (i = 0; i < threads; i++)
+		pthread_create(&tid[i], NULL, worker, &work[i]);
+	for (i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+	double elapsed = now() - start;
+
+	priqueue_destroy(&q);
+	pthread_mutex_destroy(&lock);
+
+	return threads * (double) ops / elapsed / 1e6;
+}
+
+/* Fenwick tree over the keys, counting how many of each are queued. */
+void count_add(int *tree, int key, int delta)
+{
+	for (key++; key <= MAX_KEY; key += key & -key)
+		tree[key] += delta;
+}
+
+int count_below(int *tree, int key)
+{
+	int total = 0;
+
+	for (; key > 0; key -= key & -key)
+		total += tree[key];
+
+	return total;
+}
+
+/* Mean and largest rank error of the relaxed queue with the given shards. */
+void rank_error(int shards, int ops, int *keys, double *mean, int *worst)
+{
+	priqueue_t q;
+	int *tree = calloc(MAX_KEY + 1, sizeof(int));
+	long total = 0;
+	int polls = 0;
+	int i;
+
+	priqueue_concurrent_init_flags(&q, compare, PRIQUEUE_RELAXED | PRIQUEUE_SHARDS(shards));
+	*worst = 0;
+
+	for (i = 0; i < PREFILL + ops; i++)
+	{
+		if (i < PREFILL || i % 2 == 0)
+		{
+			priqueue_offer(&q, &keys[i]);
+			count_add(tree, keys[i], 1);
+		}
+		else
+		{
+			int *key = priqueue_poll(&q);
+			int rank = count_below(tree, *key);
+
+			count_add(tree, *key, -1);
+			total += rank;
+			polls++;
+			if (rank > *worst)
+				*worst = rank;
+		}
+	}
+
+	*mean = (double) total / polls;
+
+	priqueue_destroy(&q);
+	free(tree);
+}
+
+int main(int argc, char **argv)
+{
+	int ops = argc > 1 ? atoi(argv[1]) : 200000;
+	int *keys = malloc((PREFILL + MAX_THREADS * ops) * sizeof(int));
+	int threads, i;
+
+	srand(678);
+	for (i = 0; i < PREFILL + MAX_THREADS * ops; i++)
+		keys[i] = rand() % MAX_KEY;
+
+	printf("%8s %20s %20s %20s\n", "threads", "concurrent (Mops/s)", "relaxed (Mops/s)", "mutex+list (Mops/s)");
+
+	for (threads = 1; threads <= MAX_THREADS; threads *= 2)
+		printf("%8d %20.2f %20.2f %20.2f\n", threads, run(CONCURRENT, threads, ops, keys),
+		       run(RELAXED, threads, ops, keys), run(MUTEX, threads, ops, keys));
+
+	printf("\n%8s %20s %20s\n", "shards", "mean rank error", "max rank error");
+
+	for (threads = 1; threads <= MAX_THREADS; threads *= 2)
+	{
+		double mean;
+		int worst;
+
+		rank_error(2 * threads, ops, keys, &mean, &worst);
+		printf("%8d %20.2f %20d\n", 2 * threads, mean, worst);
+	}
+
+	free(keys);
+
+	return 0;
+}
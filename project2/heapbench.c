@@ -0,0 +1,103 @@
+/** @file heapbench.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libpriqueue/libpriqueue.h"
+
+/*
+ * Compares the array layouts of the comparer-based backends as a queue
+ * outgrows the caches: the sorted list, the binary heap, the min-max heap
+ * and the cache-aligned 4-ary heap. Each run fills the queue with n random
+ * keys, then does n hold operations (poll the front and offer it again
+ * with a later key, so the size stays n), then polls it empty. Times are
+ * per offer or poll.
+ *
+ * The list's O(n) offer makes it hopeless past LIST_MAX elements, so it
+ * is only run up to there.
+ *
+ * Usage: heapbench [max elements]   (default 1000000)
+ */
+
+#define LIST_MAX 10000
+
+int compare(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ns per operation for the fill, hold and drain phases */
+void run(priqueue_backend_t backend, int *keys, int n, double *fill, double *hold, double *drain)
+{
+	priqueue_t q;
+	int i;
+
+	priqueue_init_backend(&q, compare, backend);
+	srand(678);
+
+	double start = now();
+	for (i = 0; i < n; i++)
+		priqueue_offer(&q, &keys[i]);
+	double filled = now();
+
+	for (i = 0; i < n; i++)
+	{
+		int *key = priqueue_poll(&q);
+		*key += rand() % 1000 + 1;
+		priqueue_offer(&q, key);
+	}
+	double held = now();
+
+	for (i = 0; i < n; i++)
+		priqueue_poll(&q);
+	double drained = now();
+
+	*fill = (filled - start) / n * 1e9;
+	*hold = (held - filled) / (2.0 * n) * 1e9;
+	*drain = (drained - held) / n * 1e9;
+
+	priqueue_destroy(&q);
+}
+
+int main(int argc, char **argv)
+{
+	priqueue_backend_t backends[4] = { PRIQUEUE_LIST, PRIQUEUE_HEAP, PRIQUEUE_MINMAX, PRIQUEUE_DARY };
+	int max = argc > 1 ? atoi(argv[1]) : 1000000;
+	int n, i, b;
+
+	printf("%10s %8s %16s %16s %16s\n", "elements", "backend", "offer (ns/op)", "hold (ns/op)", "poll (ns/op)");
+
+	for (n = 1000; n <= max; n *= 10)
+	{
+		int *keys = malloc(n * sizeof(int));
+
+		for (b = 0; b < 4; b++)
+		{
+			double fill, hold, drain;
+
+			if (backends[b] == PRIQUEUE_LIST && n > LIST_MAX)
+				continue;
+
+			srand(2016);
+			for (i = 0; i < n; i++)
+				keys[i] = rand() % (10 * n);
+
+			run(backends[b], keys, n, &fill, &hold, &drain);
+			printf("%10d %8s %16.1f %16.1f %16.1f\n", n, priqueue_backend_name(backends[b]), fill, hold, drain);
+		}
+
+		free(keys);
+	}
+
+	return 0;
+}
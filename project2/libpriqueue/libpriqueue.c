@@ -3,8 +3,103 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "libpriqueue.h"
+#include "priqueue_internal.h"
+
+
+static const priqueue_ops_t *backends[PRIQUEUE_NUM_BACKENDS] =
+{
+	&priqueue_list_ops,
+	&priqueue_heap_ops,
+	&priqueue_tree_ops,
+	&priqueue_minmax_ops,
+	&priqueue_dary_ops,
+	&priqueue_pairing_ops
+};
+
+static const char *backend_names[PRIQUEUE_NUM_BACKENDS] =
+{
+	"list",
+	"heap",
+	"tree",
+	"minmax",
+	"dary",
+	"pairing"
+};
+
+static const char *op_names[PRIQUEUE_NUM_OPS] =
+{
+	"offer",
+	"offer_batch",
+	"peek",
+	"poll",
+	"peek_max",
+	"poll_max",
+	"at",
+	"remove",
+	"remove_at",
+	"remove_handle",
+	"update",
+	"size",
+	"iter",
+	"merge",
+	"split"
+};
+
+
+/**
+  Counts change elements into (or, if negative, out of) q and keeps the
+  peak. Tracked here rather than read from the backend, whose size may be
+  O(n).
+ */
+#ifdef PRIQUEUE_STATS
+static void count_size(priqueue_t *q, int change)
+{
+	q->stats.size += change;
+
+	if(q->stats.size > q->stats.peak_size)
+		q->stats.peak_size = q->stats.size;
+}
+#else
+#define count_size(q, change) ((void) 0)
+#endif
+
+
+static void init_with_ops(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend, const priqueue_ops_t *ops)
+{
+	q->head = NULL;
+	q->cmp = comparer;
+	q->backend = backend;
+	q->ops = ops;
+	q->impl = NULL;
+#ifdef PRIQUEUE_STATS
+	memset(&q->stats, 0, sizeof(q->stats));
+#endif
+	priqueue_pool_init(&q->pool, 0);
+	priqueue_index_init(&q->index);
+
+	q->ops->init(q);
+}
+
+
+/**
+  Initializes dst as an empty queue of the same kind as src, if a comparer
+  is all that kind needs. Returns -1 for the kinds set up with more.
+ */
+static int init_like(priqueue_t *dst, priqueue_t *src)
+{
+	if(src->backend != PRIQUEUE_NUM_BACKENDS && src->ops == backends[src->backend])
+		priqueue_init_backend(dst, src->cmp, src->backend);
+	else if(src->ops == &priqueue_persistent_ops)
+		init_with_ops(dst, src->cmp, src->backend, src->ops);
+	else
+		return -1;
+
+	return 0;
+}
 
 
 /**
@@ -16,11 +111,196 @@
   @param q a pointer to an instance of the priqueue_t data structure
   @param comparer a function pointer that compares two elements.
   See also @ref comparer-page
+
+  The queue is built on the sorted list backend; use priqueue_init_backend()
+  to pick another one.
  */
 void priqueue_init(priqueue_t *q, int(*comparer)(const void *, const void *))
 {
-	q->head = NULL;
-	q->cmp = comparer;
+	priqueue_init_backend(q, comparer, PRIQUEUE_LIST);
+}
+
+
+/**
+  Initializes the priqueue_t data structure on a specific storage backend.
+
+  All backends share the same semantics, including FIFO order among
+  elements that compare equal, so they can be swapped freely. Pick
+  PRIQUEUE_PAIRING for queues that are combined with priqueue_merge().
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param backend the storage backend to build the queue on
+ */
+void priqueue_init_backend(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend)
+{
+	init_with_ops(q, comparer, backend, backends[backend]);
+}
+
+
+/**
+  Initializes the priqueue_t data structure as an intrusive queue.
+
+  Every element must embed a struct pq_node (see pqtree.h) at node_offset,
+  e.g. offsetof(job_t, node). The queue links those nodes directly, so
+  offer and poll never allocate. It behaves like the tree backend, except
+  that an element can be queued at most once at a time.
+
+  priqueue_remove() tells a queued element from one that is not by its
+  node, so each node must be cleared with pq_node_init() when its element
+  is created. Polling or removing an element clears its node again.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param node_offset offset of the embedded struct pq_node in each element
+ */
+void priqueue_init_intrusive(priqueue_t *q, int(*comparer)(const void *, const void *), unsigned long node_offset)
+{
+	init_with_ops(q, comparer, PRIQUEUE_TREE, &priqueue_intrusive_ops);
+	priqueue_tree_set_offset(q, node_offset);
+}
+
+
+/**
+  Initializes the priqueue_t data structure as a bucket queue, for elements
+  ordered first by a small integer key.
+
+  Each key from min_key to max_key gets its own FIFO-ordered bucket; keys
+  outside the range share the first or last one, which stays correct but
+  gets slower as they fill up. Offer and poll are O(1) amortized when
+  elements with the same key arrive in comparer order. key must agree with
+  comparer: if comparer(a, b) < 0 then key(a) <= key(b). priqueue_offer
+  returns the element's position among those in its bucket.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param key a function pointer that returns an element's integer key
+  @param min_key the smallest key with a bucket of its own
+  @param max_key the largest key with a bucket of its own
+ */
+void priqueue_init_bucket(priqueue_t *q, int(*comparer)(const void *, const void *), int(*key)(const void *), int min_key, int max_key)
+{
+	//not one of the interchangeable backends, so it has no priqueue_backend_t
+	init_with_ops(q, comparer, PRIQUEUE_NUM_BACKENDS, &priqueue_bucket_ops);
+	priqueue_bucket_set_range(q, key, min_key, max_key);
+}
+
+
+/**
+  Initializes the priqueue_t data structure as a radix heap, for elements
+  ordered by an unsigned 64-bit key that never goes below the last key
+  polled, such as the times in an event queue.
+
+  Offer is O(1) and poll O(log C) amortized, where C is the spread of the
+  keys. Elements with equal keys leave in FIFO order; no comparer is used.
+  Offering or updating an element to a key below the last one polled is
+  an error, caught by an assertion in debug builds. priqueue_at,
+  priqueue_remove_at and cursors are O(n log n). priqueue_offer returns
+  the element's internal bucket, which is 0 when its key equals the last
+  one polled.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param key a function pointer that returns an element's key
+ */
+void priqueue_init_radix(priqueue_t *q, unsigned long long (*key)(const void *))
+{
+	//not one of the interchangeable backends, so it has no priqueue_backend_t
+	init_with_ops(q, NULL, PRIQUEUE_NUM_BACKENDS, &priqueue_radix_ops);
+	priqueue_radix_set_key(q, key);
+}
+
+
+/**
+  Initializes the priqueue_t data structure with cached 64-bit keys.
+
+  Every element is ordered by an unsigned key stored next to it, lowest
+  first, with equal keys in FIFO order; no comparer is used. Keys are
+  given with priqueue_offer_keyed() and priqueue_rekey(), or computed by
+  key, once, when an element goes through priqueue_offer() or
+  priqueue_update(). Keys are kept apart from the element pointers, so
+  sifting compares integers in contiguous memory instead of loading two
+  elements per step. priqueue_at, priqueue_remove_at and cursors are
+  O(n + index log n).
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param key a function pointer that returns an element's key, or NULL
+ */
+void priqueue_init_keyed(priqueue_t *q, unsigned long long (*key)(const void *))
+{
+	//not one of the interchangeable backends, so it has no priqueue_backend_t
+	init_with_ops(q, NULL, PRIQUEUE_NUM_BACKENDS, &priqueue_keyed_ops);
+	priqueue_keyed_set_key(q, key);
+}
+
+
+/**
+  Initializes the priqueue_t data structure as a persistent heap, which
+  priqueue_clone() copies in O(1).
+
+  Versions made by priqueue_clone() share their nodes until they diverge,
+  so a clone costs memory in proportion to the changes made to it or its
+  original since, not to its size. Offer and poll are O(log n); the
+  element's handle is valid in every clone that still holds it. Removal
+  through a handle is O(log n) for elements near the front and O(n) at
+  worst; priqueue_remove and priqueue_update are O(n). Clones of one queue
+  must not be used from several threads at once.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+ */
+void priqueue_init_persistent(priqueue_t *q, int(*comparer)(const void *, const void *))
+{
+	//not one of the interchangeable backends, so it has no priqueue_backend_t
+	init_with_ops(q, comparer, PRIQUEUE_NUM_BACKENDS, &priqueue_persistent_ops);
+}
+
+
+/**
+  Initializes the priqueue_t data structure for use by several threads at once.
+
+  The queue is a lock-free skiplist. priqueue_offer, priqueue_poll,
+  priqueue_peek and priqueue_size are linearizable, as is removal through a
+  handle or priqueue_remove. priqueue_at, priqueue_remove_at and cursors
+  are safe to call concurrently but only see a consistent order when no
+  other thread changes the queue. priqueue_update is the exception: it is
+  O(n) and needs the queue to itself. priqueue_destroy must run after all
+  other threads are done with the queue.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+ */
+void priqueue_concurrent_init(priqueue_t *q, int(*comparer)(const void *, const void *))
+{
+	//not one of the interchangeable backends, so it has no priqueue_backend_t
+	priqueue_concurrent_init_flags(q, comparer, 0);
+}
+
+
+/**
+  Initializes the priqueue_t data structure for use by several threads at
+  once, as priqueue_concurrent_init() does, with options.
+
+  With PRIQUEUE_RELAXED the queue is a MultiQueue: a set of separately
+  locked heaps, where offers go to a random shard and polls take the
+  better head of two random shards. It scales much further than the
+  skiplist, but priqueue_poll and priqueue_peek only return an element
+  close to the front, not necessarily the front. Everything else behaves
+  as for the skiplist, except that priqueue_at, priqueue_remove_at and
+  cursors lock the whole queue, and priqueue_update is thread-safe.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param flags 0, or PRIQUEUE_RELAXED optionally or'ed with PRIQUEUE_SHARDS(n)
+ */
+void priqueue_concurrent_init_flags(priqueue_t *q, int(*comparer)(const void *, const void *), int flags)
+{
+	//not one of the interchangeable backends, so it has no priqueue_backend_t
+	if(!(flags & PRIQUEUE_RELAXED)) {
+		init_with_ops(q, comparer, PRIQUEUE_NUM_BACKENDS, &priqueue_concurrent_ops);
+		return;
+	}
+
+	int shards = flags >> 8;
+
+	if(shards <= 0)
+		shards = 2 * (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if(shards <= 0)
+		shards = 2;
+
+	init_with_ops(q, comparer, PRIQUEUE_NUM_BACKENDS, &priqueue_multiqueue_ops);
+	priqueue_multiqueue_set_shards(q, shards);
 }
 
 
@@ -29,52 +309,96 @@ void priqueue_init(priqueue_t *q, int(*comparer)(const void *, const void *))
 
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr a pointer to the data to be inserted into the priority queue
-  @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue.
+  @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue. The heap backend returns the element's position in the heap array, which is 0 only for the front.
+  @return -1 if the element could not be stored
  */
 int priqueue_offer(priqueue_t *q, void *ptr)
 {
-	struct node *temp;
-	struct node *previous;
-	struct node *insert = malloc(sizeof(struct node));
+	return priqueue_offer_handle(q, ptr, NULL);
+}
 
-	insert->data = ptr;
-	insert->next = NULL;
 
-	//check for other nodes
-	if (q->head == NULL) {
-		q->head = insert;
-	}
-	//compare the new node to the first node
-	else if(q->cmp(insert->data, q->head->data) < 0) {
-		insert->next = q->head;
-		q->head = insert;
+/**
+  Inserts the specified element and hands back a handle to it.
+
+  The handle can be passed to priqueue_update() after the element's key
+  changes. It is valid until the element is polled or removed.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @param handle set to the new element's handle
+  @return the same value as priqueue_offer()
+ */
+int priqueue_offer_handle(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	int index = q->ops->offer(q, ptr, handle);
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_OFFER]);
+	if(index >= 0)
+		count_size(q, 1);
+
+	return index;
+}
+
+
+/**
+  Inserts the specified element under an explicit key.
+
+  On a queue from priqueue_init_keyed() the element is ordered by key.
+  Any other queue ignores key and orders the element by its comparer, as
+  priqueue_offer_handle() does.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @param key the element's key; lower keys come first
+  @param handle set to the new element's handle, if not NULL
+  @return the same value as priqueue_offer()
+ */
+int priqueue_offer_keyed(priqueue_t *q, void *ptr, unsigned long long key, priqueue_handle_t *handle)
+{
+	if(q->ops != &priqueue_keyed_ops)
+		return priqueue_offer_handle(q, ptr, handle);
+
+	int index = priqueue_keyed_offer(q, ptr, key, handle);
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_OFFER]);
+	if(index >= 0)
+		count_size(q, 1);
+
+	return index;
+}
+
+
+/**
+  Inserts n elements at once.
+
+  Elements that compare equal keep their order in ptrs, after any equal
+  ones already queued. The heap backend heapifies in linear time and the
+  list backend merges a sorted batch in one pass; others insert one by one.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptrs the elements to insert
+  @param n the number of elements in ptrs
+  @return the number of elements inserted, less than n only if memory ran out
+ */
+int priqueue_offer_batch(priqueue_t *q, void **ptrs, int n)
+{
+	int i;
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_OFFER_BATCH]);
+
+	if(q->ops->offer_batch) {
+		i = q->ops->offer_batch(q, ptrs, n);
 	}
 	else {
-		previous = q->head;
-		temp = q->head->next;
-
-		//determine where the new node needs to be inserted 
-		while(temp != NULL && q->cmp(insert->data, temp->data) > 0)
-		{
-			previous = temp;
-			temp = temp->next;
-		}
-
-		//insert the node at the position
-		if(temp == NULL)
-		{
-			previous->next = insert;
-		}
-		else
-		{
-			insert->next = temp;
-			previous->next = insert;
-		}
+		for(i = 0; i < n; i++)
+			if(q->ops->offer(q, ptrs[i], NULL) < 0)
+				break;
 	}
 
-	return priqueue_size(q)-1;
+	count_size(q, i);
+
+	return i;
 }
 
+
 /**
   Retrieves, but does not remove, the head of this queue, returning NULL if
   this queue is empty.
@@ -85,7 +409,9 @@ int priqueue_offer(priqueue_t *q, void *ptr)
  */
 void *priqueue_peek(priqueue_t *q)
 {
-	return q->head->data;
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_PEEK]);
+
+	return q->ops->peek(q);
 }
 
 
@@ -99,13 +425,85 @@ void *priqueue_peek(priqueue_t *q)
  */
 void *priqueue_poll(priqueue_t *q)
 {
-	void* value = q->head->data;
-	q->head = q->head->next;
-	
+	void *value = q->ops->poll(q);
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_POLL]);
+	if(value)
+		count_size(q, -1);
+
+	return value;
+}
+
+
+/**
+  Retrieves, but does not remove, the tail of this queue: the element
+  that would be polled last. NULL if this queue is empty.
+
+  O(1) on the min-max backend; others look the element up with
+  priqueue_at(), which is O(log n) on the tree.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @return the tail of this queue
+  @return NULL if this queue is empty
+ */
+void *priqueue_peek_max(priqueue_t *q)
+{
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_PEEK_MAX]);
+
+	if(q->ops->peek_max)
+		return q->ops->peek_max(q);
+
+	return q->ops->at(q, q->ops->size(q) - 1);
+}
+
+
+/**
+  Retrieves and removes the tail of this queue, or NULL if this queue is
+  empty.
+
+  O(log n) on the min-max backend; others go through priqueue_remove_at().
+  @param q a pointer to an instance of the priqueue_t data structure
+  @return the tail of this queue
+  @return NULL if this queue is empty
+ */
+void *priqueue_poll_max(priqueue_t *q)
+{
+	void *value;
+
+	if(q->ops->poll_max)
+		value = q->ops->poll_max(q);
+	else
+		value = q->ops->remove_at(q, q->ops->size(q) - 1);
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_POLL_MAX]);
+	if(value)
+		count_size(q, -1);
+
 	return value;
 }
 
 
+/**
+  Retrieves and removes up to k elements from the head of this queue.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param out receives the elements, in priority order
+  @param k the most elements to remove
+  @return the number of elements stored in out, less than k if the queue ran out
+ */
+int priqueue_poll_n(priqueue_t *q, void **out, int k)
+{
+	int i;
+	for(i = 0; i < k; i++)
+		if((out[i] = q->ops->poll(q)) == NULL)
+			break;
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_POLL]);
+	count_size(q, -i);
+
+	return i;
+}
+
+
 /**
   Returns the element at the specified position in this list, or NULL if
   the queue does not contain an index'th element.
@@ -117,17 +515,9 @@ void *priqueue_poll(priqueue_t *q)
  */
 void *priqueue_at(priqueue_t *q, int index)
 {
-	int i = 0;
-	struct node *n = malloc(sizeof(struct node));
-	n = q->head;
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_AT]);
 
-	while(i != index && n != NULL) {
-		n = n->next;
-
-		i++;
-	}
-	
-	return n->data;
+	return q->ops->at(q, index);
 }
 
 
@@ -135,6 +525,10 @@ void *priqueue_at(priqueue_t *q, int index)
   Removes all instances of ptr from the queue. 
   
   This function should not use the comparer function, but check if the data contained in each element of the queue is equal (==) to ptr.
+
+  Instances are found through the queue's pointer-to-handle hash index
+  (or by offset, for an intrusive queue), so each one costs O(1) expected
+  to find plus one priqueue_remove_handle().
  
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr address of element to be removed
@@ -143,33 +537,44 @@ void *priqueue_at(priqueue_t *q, int index)
 int priqueue_remove(priqueue_t *q, void *ptr)
 {
 	int numRemoved = 0;
-	struct node* previous, *temp;
-
-	temp = q->head;
-	
-	while(temp != NULL) {
-		if(q->cmp(temp->data, ptr) == 0) {
-			if(previous == NULL) {
-				q->head = q->head->next;
-				temp = q->head;
-			}
-			else {
-				previous->next = temp->next;
-				temp = previous->next;
-			}
-			
+	priqueue_handle_t handle;
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_REMOVE]);
+
+	if(q->ops->remove) {
+		numRemoved = q->ops->remove(q, ptr);
+	}
+	else {
+		while((handle = q->ops->find(q, ptr)) != NULL) {
+			q->ops->remove_handle(q, handle);
 			numRemoved++;
 		}
-		else {
-			previous = temp;
-			temp = temp->next;
-		}
 	}
 
+	count_size(q, -numRemoved);
+
 	return numRemoved;
 }
 
 
+/**
+  Removes one known element from the queue.
+
+  O(log n) on the heap and tree backends; O(n) on the list, which has to
+  find the node's predecessor.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle the handle of the element, from priqueue_offer_handle()
+  @return the removed element
+ */
+void *priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_REMOVE_HANDLE]);
+	count_size(q, -1);
+
+	return q->ops->remove_handle(q, handle);
+}
+
+
 /**
   Removes the specified index from the queue, moving later elements up
   a spot in the queue to fill the gap.
@@ -181,26 +586,52 @@ int priqueue_remove(priqueue_t *q, void *ptr)
  */
 void *priqueue_remove_at(priqueue_t *q, int index)
 {
-	int i = 0;
-	struct node* prev = malloc(sizeof(struct node));
-	struct node* n = malloc(sizeof(struct node));
-	n = q->head;
-	
-	while(i != index && n != NULL) {
-		prev = n;
-		n = n->next;
+	void *value = q->ops->remove_at(q, index);
 
-		i++;
-	}
-	
-	if(n == q->head) {
-		q->head = q->head->next;
-	}
-	else if(n != NULL) {
-		prev->next = n->next;
-	}
-	
-	return n->data;
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_REMOVE_AT]);
+	if(value)
+		count_size(q, -1);
+
+	return value;
+}
+
+
+/**
+  Restores the queue's order after the key of one element has changed.
+
+  Call this whenever a field the comparer reads is modified while the
+  element is queued, in either direction. O(log n) on the heap and tree
+  backends, where equal elements keep their original FIFO order; O(n) on
+  the list, which re-inserts the element after its equals.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle the handle of the changed element
+ */
+void priqueue_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_UPDATE]);
+
+	q->ops->update(q, handle);
+}
+
+
+/**
+  Gives one element a new key and restores the queue's order, O(log n).
+
+  On a queue from priqueue_init_keyed() this replaces the cached key.
+  Any other queue ignores key and behaves as priqueue_update(), so the
+  element's fields must already hold their new values.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle the handle of the changed element
+  @param key the element's new key
+ */
+void priqueue_rekey(priqueue_t *q, priqueue_handle_t handle, unsigned long long key)
+{
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_UPDATE]);
+
+	if(q->ops == &priqueue_keyed_ops)
+		priqueue_keyed_rekey(q, handle, key);
+	else
+		q->ops->update(q, handle);
 }
 
 
@@ -212,16 +643,247 @@ void *priqueue_remove_at(priqueue_t *q, int index)
  */
 int priqueue_size(priqueue_t *q)
 {
-	int count = 0;
-	struct node* n;
-	n = q->head;
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_SIZE]);
+
+	return q->ops->size(q);
+}
+
+
+/**
+  Initializes dst as a copy of src, with the same elements in the same
+  order.
+
+  On a queue from priqueue_init_persistent() this is O(1), and handles
+  from src are valid in dst too. Queues from priqueue_init() or
+  priqueue_init_backend() are copied element by element, O(n log n), and
+  their handles only refer to src. Other kinds of queue can not be copied.
+  @param dst the queue to initialize, as if by one of the priqueue_init functions
+  @param src the queue to copy
+  @return 0 on success
+  @return -1 if src can not be copied or memory ran out, leaving dst uninitialized
+ */
+int priqueue_clone(priqueue_t *dst, priqueue_t *src)
+{
+	priqueue_iter_t it;
+	void *ptr;
+
+	if(init_like(dst, src) < 0)
+		return -1;
+
+	if(src->ops->clone) {
+		if(src->ops->clone(dst, src) < 0) {
+			priqueue_destroy(dst);
+			return -1;
+		}
+
+		count_size(dst, src->ops->size(src));
+		return 0;
+	}
+
+	//in priority order, so equal elements keep their FIFO order
+	for(ptr = priqueue_iter_begin(src, &it); ptr != NULL; ptr = priqueue_iter_next(&it)) {
+		if(priqueue_offer(dst, ptr) < 0) {
+			priqueue_iter_end(&it);
+			priqueue_destroy(dst);
+			return -1;
+		}
+	}
+	priqueue_iter_end(&it);
+
+	if(it.error) {
+		priqueue_destroy(dst);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+  Moves every element of src into dst, leaving src empty.
+
+  Two PRIQUEUE_PAIRING queues with the same comparer merge by one link and
+  an O(1) splice of their node pools, plus O(min(n, m)) expected to fold
+  the smaller queue's handle index, which priqueue_remove searches, into
+  the larger's. Two queues from priqueue_init_persistent() merge in
+  O(log n). In both cases the handles from src are valid in dst
+  afterwards. Any other pair of queues is merged
+  by polling src and offering to dst, O(m log(n + m)), and the moved
+  elements get new handles. Elements from src keep their order among
+  themselves, but where they fall among equal elements of dst is
+  unspecified.
+  @param dst the queue to merge into
+  @param src the queue to empty; it stays initialized
+  @return the number of elements moved
+  @return -1 if memory ran out, leaving the elements not yet moved in src
+ */
+int priqueue_merge(priqueue_t *dst, priqueue_t *src)
+{
+	int moved = 0;
+	void *ptr;
+
+	PRIQUEUE_COUNT(dst, calls[PRIQUEUE_OP_MERGE]);
 
-	while(n != NULL) {
-		n = n->next;
-		count++;
+	if(dst->ops == src->ops && dst->cmp == src->cmp && dst->ops->merge) {
+		moved = src->ops->size(src);
+
+		//the index is the only step that can fail, so it goes first
+		if(!priqueue_index_merge(&dst->index, &src->index) || dst->ops->merge(dst, src) < 0)
+			return -1;
+
+		priqueue_pool_merge(&dst->pool, &src->pool);
+		count_size(dst, moved);
+		count_size(src, -moved);
+
+		return moved;
 	}
 
-	return count;
+	while((ptr = priqueue_poll(src)) != NULL) {
+		if(priqueue_offer(dst, ptr) < 0) {
+			priqueue_offer(src, ptr);
+			return -1;
+		}
+
+		moved++;
+	}
+
+	return moved;
+}
+
+
+/**
+  Moves the elements predicate accepts from q into out, keeping their
+  order.
+
+  out is initialized as the same kind of queue as q, which must be one
+  priqueue_clone() can copy. A PRIQUEUE_PAIRING queue is split in O(n);
+  others go through a cursor, O(n log n). Elements that stay in q keep
+  their handles, and the moved ones get new handles in out.
+  @param q the queue to split
+  @param out the queue to initialize, as if by one of the priqueue_init functions
+  @param predicate returns non-zero for the elements to move; it must not change q
+  @param arg passed to predicate along with each element
+  @return the number of elements moved
+  @return -1 if out can not be made like q, leaving it uninitialized, or
+          if memory ran out, leaving out initialized with the elements moved so far
+ */
+int priqueue_split(priqueue_t *q, priqueue_t *out, int (*predicate)(const void *ptr, void *arg), void *arg)
+{
+	priqueue_iter_t it;
+	int moved = 0;
+	void *ptr;
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_SPLIT]);
+
+	if(init_like(out, q) < 0)
+		return -1;
+
+	if(q->ops->split) {
+		moved = q->ops->split(q, out, predicate, arg);
+
+		if(moved > 0) {
+			count_size(q, -moved);
+			count_size(out, moved);
+		}
+
+		return moved;
+	}
+
+	for(ptr = priqueue_iter_begin(q, &it); ptr != NULL; ptr = priqueue_iter_next(&it)) {
+		if(!predicate(ptr, arg))
+			continue;
+
+		//offered before it is taken out, so running out of memory loses nothing
+		if(priqueue_offer(out, ptr) < 0) {
+			priqueue_iter_end(&it);
+			return -1;
+		}
+
+		priqueue_iter_remove_current(&it);
+		moved++;
+	}
+	priqueue_iter_end(&it);
+
+	return it.error ? -1 : moved;
+}
+
+
+/**
+  Opens a cursor on the head of the queue.
+
+  Walking the whole queue with priqueue_iter_next() costs O(n) on the list
+  and tree backends and O(n log n) on the heap, instead of restarting
+  from the head for every priqueue_at(). Every cursor must be closed with
+  priqueue_iter_end().
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param it the cursor to open
+  @return the head of the queue
+  @return NULL if the queue is empty, or if memory ran out for the copy a
+          heap-ordered backend walks, which sets it->error
+ */
+void *priqueue_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	it->q = q;
+	it->current = NULL;
+	it->next = NULL;
+	it->prev = NULL;
+	it->order = NULL;
+	it->remaining = 0;
+	it->error = 0;
+
+	PRIQUEUE_COUNT(q, calls[PRIQUEUE_OP_ITER]);
+
+	return q->ops->iter_begin(q, it);
+}
+
+
+/**
+  Moves the cursor to the next element in priority order. After
+  priqueue_iter_remove_current() this is the element that followed the
+  removed one.
+
+  @param it an open cursor
+  @return the next element
+  @return NULL if the end of the queue was reached
+ */
+void *priqueue_iter_next(priqueue_iter_t *it)
+{
+	return it->q->ops->iter_next(it);
+}
+
+
+/**
+  Removes the element under the cursor without another traversal. The
+  cursor stays open; priqueue_iter_next() continues after the removed
+  element.
+
+  @param it an open cursor on an element
+  @return the removed element
+ */
+void *priqueue_iter_remove_current(priqueue_iter_t *it)
+{
+	void *value = it->q->ops->iter_remove(it);
+
+	it->current = NULL;
+	PRIQUEUE_COUNT(it->q, calls[PRIQUEUE_OP_REMOVE_HANDLE]);
+	count_size(it->q, -1);
+
+	return value;
+}
+
+
+/**
+  Closes a cursor opened by priqueue_iter_begin().
+
+  @param it the cursor
+ */
+void priqueue_iter_end(priqueue_iter_t *it)
+{
+	if(it->q->ops->iter_end)
+		it->q->ops->iter_end(it);
+
+	free(it->order);
+	it->order = NULL;
 }
 
 
@@ -232,11 +894,87 @@ int priqueue_size(priqueue_t *q)
  */
 void priqueue_destroy(priqueue_t *q)
 {
-	struct node* curr = malloc(sizeof(struct node));
+	q->ops->destroy(q);
+	priqueue_pool_destroy(&q->pool);
+	priqueue_index_destroy(&q->index);
+}
+
+
+/**
+  Reports how much of the queue's node pool is in use. Every queued
+  element holds one node (the heap's are its position slots).
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param live set to the number of nodes currently holding elements
+  @param slabs set to the number of slabs the pool has allocated
+ */
+void priqueue_pool_usage(priqueue_t *q, int *live, int *slabs)
+{
+	*live = q->pool.live;
+	*slabs = q->pool.num_slabs;
+}
+
+
+/**
+  Copies out the queue's operation counters.
+
+  The counters are only kept when the library is built with PRIQUEUE_STATS
+  defined (make STATS=1), so that without it they cost nothing at all.
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param out set to the counters, or zeroed if they are not kept
+  @return 1 if the counters are kept, 0 if not
+ */
+int priqueue_stats(priqueue_t *q, priqueue_stats_t *out)
+{
+#ifdef PRIQUEUE_STATS
+	*out = q->stats;
+	return 1;
+#else
+	memset(out, 0, sizeof(*out));
+	return 0;
+#endif
+}
 
-	while ((curr = q->head) != NULL) {
-		q->head = q->head->next;
-		free(curr);
+
+/**
+  Returns the short name of a backend, as accepted by priqueue_backend_lookup().
+
+  @param backend a storage backend
+  @return the backend's name
+ */
+const char *priqueue_backend_name(priqueue_backend_t backend)
+{
+	return backend_names[backend];
+}
+
+
+/**
+  Finds the backend with the given short name (e.g. "list", "heap").
+
+  @param name the name to look up
+  @return the matching backend
+  @return PRIQUEUE_NUM_BACKENDS if no backend has that name
+ */
+priqueue_backend_t priqueue_backend_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < PRIQUEUE_NUM_BACKENDS; i++) {
+		if (strcmp(name, backend_names[i]) == 0)
+			return (priqueue_backend_t) i;
 	}
 
+	return PRIQUEUE_NUM_BACKENDS;
+}
+
+
+/**
+  Returns the short name of an operation, for printing priqueue_stats_t::calls.
+
+  @param op a public operation
+  @return the operation's name
+ */
+const char *priqueue_op_name(priqueue_op_t op)
+{
+	return op_names[op];
 }
@@ -4,10 +4,38 @@
 #ifndef LIBPRIQUEUE_H_
 #define LIBPRIQUEUE_H_
 
+#ifndef __cplusplus
 #define true 1
 #define false 0
 
 typedef unsigned int bool;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  Storage backends a priqueue_t can be built on, chosen at init time.
+*/
+typedef enum
+{
+	PRIQUEUE_LIST = 0,  /**< sorted singly linked list, O(n) offer */
+	PRIQUEUE_HEAP,      /**< array-backed binary heap, O(log n) offer/poll */
+	PRIQUEUE_TREE,      /**< order-statistic treap, O(log n) at/remove_at, O(1) size */
+	PRIQUEUE_MINMAX,    /**< min-max heap, O(1) peek/peek_max, O(log n) poll/poll_max */
+	PRIQUEUE_DARY,      /**< 4-ary heap, one cache line per sibling group, for large queues */
+	PRIQUEUE_PAIRING,   /**< pairing heap, O(1) offer, O(log n) amortized poll, O(min(n, m)) priqueue_merge */
+	PRIQUEUE_NUM_BACKENDS
+} priqueue_backend_t;
+
+/**
+  Flags for priqueue_concurrent_init_flags(). PRIQUEUE_RELAXED trades exact
+  priority order for throughput; PRIQUEUE_SHARDS(n) sets how many shards a
+  relaxed queue has (default: two per online CPU).
+*/
+#define PRIQUEUE_RELAXED   0x1
+#define PRIQUEUE_SHARDS(n) ((n) << 8)
 
 /**
   Priqueue Data Structure
@@ -19,22 +47,158 @@ struct node
 	struct node *next;
 };
 
+/**
+  Per-queue node allocator. Nodes are carved out of contiguous slabs and
+  recycled through an intrusive free list; all slabs are released together
+  when the queue is destroyed.
+*/
+typedef struct _priqueue_pool_t
+{
+	unsigned int object_size;
+	int next_slab_objects;
+	void *slabs, *slab_tail;
+	void *free_list, *free_tail;  // the tails let priqueue_merge splice in O(1)
+	int live, num_slabs;
+} priqueue_pool_t;
+
+/**
+  Opaque reference to one element of a queue. It stays valid, whatever else
+  is offered or removed, until that element itself leaves the queue.
+*/
+typedef struct _priqueue_handle *priqueue_handle_t;
+
+/**
+  Hash index from element pointer to handle, so elements can be found by
+  address without a scan.
+*/
+typedef struct _priqueue_index_entry_t
+{
+	void *ptr;
+	priqueue_handle_t handle;
+} priqueue_index_entry_t;
+
+typedef struct _priqueue_index_t
+{
+	priqueue_index_entry_t *entries;
+	unsigned long capacity, count;
+} priqueue_index_t;
+
+/**
+  Public operations, as counted in priqueue_stats_t::calls.
+*/
+typedef enum
+{
+	PRIQUEUE_OP_OFFER = 0,       /**< priqueue_offer, _offer_handle, _offer_keyed */
+	PRIQUEUE_OP_OFFER_BATCH,
+	PRIQUEUE_OP_PEEK,
+	PRIQUEUE_OP_POLL,            /**< priqueue_poll, _poll_n */
+	PRIQUEUE_OP_PEEK_MAX,
+	PRIQUEUE_OP_POLL_MAX,
+	PRIQUEUE_OP_AT,
+	PRIQUEUE_OP_REMOVE,
+	PRIQUEUE_OP_REMOVE_AT,
+	PRIQUEUE_OP_REMOVE_HANDLE,   /**< also priqueue_iter_remove_current */
+	PRIQUEUE_OP_UPDATE,          /**< priqueue_update, _rekey */
+	PRIQUEUE_OP_SIZE,
+	PRIQUEUE_OP_ITER,            /**< cursors opened */
+	PRIQUEUE_OP_MERGE,
+	PRIQUEUE_OP_SPLIT,
+	PRIQUEUE_NUM_OPS
+} priqueue_op_t;
+
+/**
+  Operation counters, kept only when the library is built with
+  PRIQUEUE_STATS defined (make STATS=1); otherwise priqueue_t has no room
+  for them and nothing is counted. Counters are plain increments, so on a
+  queue shared between threads they are approximate.
+*/
+typedef struct _priqueue_stats_t
+{
+	unsigned long comparisons;  // comparer calls, or key comparisons on a keyed queue
+	unsigned long hops;         // links followed or levels moved while searching and sifting
+	unsigned long allocs, frees;  // nodes taken from and returned to the pool
+	int size, peak_size;        // elements queued now and at most
+	unsigned long calls[PRIQUEUE_NUM_OPS];
+} priqueue_stats_t;
+
+struct _priqueue_ops;
+
 typedef struct _priqueue_t
 {
 	int(*cmp)(const void *, const void *);
 	struct node *head;
+	priqueue_pool_t pool;
+	priqueue_index_t index;
+
+	priqueue_backend_t backend;
+	const struct _priqueue_ops *ops;
+	void *impl;
+#ifdef PRIQUEUE_STATS
+	priqueue_stats_t stats;
+#endif
 } priqueue_t;
 
+/**
+  Cursor over a queue in priority order, from priqueue_iter_begin(). The
+  only change allowed while it is open is priqueue_iter_remove_current();
+  any other offer, removal or update invalidates it.
+*/
+typedef struct _priqueue_iter_t
+{
+	priqueue_t *q;
+	priqueue_handle_t current;  // NULL once removed
+	priqueue_handle_t next;     // tree: successor of a removed node
+	void *prev;                 // list: node before current; concurrent: thread record
+	void *order;                // heap, minmax, dary, pairing: private copy of the heap, drained in order; relaxed: shard cursors;
+	                            // persistent: private version, polled in order
+	int remaining;              // relaxed: shard of current
+	int error;                  // set when memory ran out opening the cursor
+} priqueue_iter_t;
+
 
 void   priqueue_init     (priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_init_backend(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend);
+void   priqueue_init_intrusive(priqueue_t *q, int(*comparer)(const void *, const void *), unsigned long node_offset);
+void   priqueue_init_bucket(priqueue_t *q, int(*comparer)(const void *, const void *), int(*key)(const void *), int min_key, int max_key);
+void   priqueue_init_radix(priqueue_t *q, unsigned long long (*key)(const void *));
+void   priqueue_init_keyed(priqueue_t *q, unsigned long long (*key)(const void *));
+void   priqueue_init_persistent(priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_concurrent_init(priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_concurrent_init_flags(priqueue_t *q, int(*comparer)(const void *, const void *), int flags);
 int    priqueue_offer    (priqueue_t *q, void *ptr);
+int    priqueue_offer_handle(priqueue_t *q, void *ptr, priqueue_handle_t *handle);
+int    priqueue_offer_keyed(priqueue_t *q, void *ptr, unsigned long long key, priqueue_handle_t *handle);
+int    priqueue_offer_batch(priqueue_t *q, void **ptrs, int n);
 void * priqueue_peek     (priqueue_t *q);
 void * priqueue_poll     (priqueue_t *q);
+void * priqueue_peek_max (priqueue_t *q);
+void * priqueue_poll_max (priqueue_t *q);
+int    priqueue_poll_n   (priqueue_t *q, void **out, int k);
 void * priqueue_at       (priqueue_t *q, int index);
 int    priqueue_remove   (priqueue_t *q, void *ptr);
 void * priqueue_remove_at(priqueue_t *q, int index);
+void   priqueue_rekey    (priqueue_t *q, priqueue_handle_t handle, unsigned long long key);
+void   priqueue_update   (priqueue_t *q, priqueue_handle_t handle);
+void * priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle);
 int    priqueue_size     (priqueue_t *q);
+int    priqueue_clone    (priqueue_t *dst, priqueue_t *src);
+int    priqueue_merge    (priqueue_t *dst, priqueue_t *src);
+int    priqueue_split    (priqueue_t *q, priqueue_t *out, int (*predicate)(const void *ptr, void *arg), void *arg);
+void * priqueue_iter_begin(priqueue_t *q, priqueue_iter_t *it);
+void * priqueue_iter_next (priqueue_iter_t *it);
+void * priqueue_iter_remove_current(priqueue_iter_t *it);
+void   priqueue_iter_end  (priqueue_iter_t *it);
+void   priqueue_pool_usage(priqueue_t *q, int *live, int *slabs);
+int    priqueue_stats    (priqueue_t *q, priqueue_stats_t *out);
 
 void   priqueue_destroy  (priqueue_t *q);
 
+const char *       priqueue_backend_name  (priqueue_backend_t backend);
+priqueue_backend_t priqueue_backend_lookup(const char *name);
+const char *       priqueue_op_name       (priqueue_op_t op);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* LIBPQUEUE_H_ */
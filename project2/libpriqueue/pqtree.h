@@ -0,0 +1,347 @@
+#ifndef __PQTREE_H
+#define __PQTREE_H
+
+/*
+* Intrusive priority queue, in the style of project3/list.h.
+*
+* The queue is an order-statistic treap: a binary search tree ordered by
+* the user's comparer (ties broken by insertion order), kept balanced by
+* random heap priorities, with every node counting the size of its
+* subtree. Embed a struct pq_node in your own structure and get back to
+* it with pq_entry(); nothing is allocated by the queue itself.
+*
+* Besides insert/first/erase in O(log n) expected, the subtree sizes give
+* pq_at() (the index'th element in order) in O(log n), and pq_update()
+* re-positions a node whose key changed.
+*/
+
+struct pq_node {
+	struct pq_node *left, *right, *parent;
+	unsigned long seq;
+	unsigned int prio;
+	int size;	/* 0 while the node is not in a queue */
+};
+
+struct pq_root {
+	struct pq_node *root;
+	int (*cmp)(const struct pq_node *a, const struct pq_node *b, void *arg);
+	void *arg;
+	unsigned long next_seq;
+	unsigned int rng;
+};
+
+/**
+* pq_root_init - initialize an empty queue
+* @root: the queue
+* @cmp: compares two nodes like qsort's comparer; @arg is passed through
+* @arg: user data for @cmp
+*/
+static inline void pq_root_init(struct pq_root *root,
+int (*cmp)(const struct pq_node *, const struct pq_node *, void *), void *arg)
+{
+	root->root = 0;
+	root->cmp = cmp;
+	root->arg = arg;
+	root->next_seq = 0;
+	root->rng = 2463534242u;
+}
+
+/**
+* pq_node_init - mark a node as not queued
+* @node: the node
+*/
+static inline void pq_node_init(struct pq_node *node)
+{
+	node->size = 0;
+}
+
+/**
+* pq_node_queued - tests whether a node is in a queue
+* @node: the node
+*/
+static inline int pq_node_queued(const struct pq_node *node)
+{
+	return node->size != 0;
+}
+
+/**
+* pq_size - number of nodes in the queue, O(1)
+* @root: the queue
+*/
+static inline int pq_size(const struct pq_root *root)
+{
+	return root->root ? root->root->size : 0;
+}
+
+static inline int __pq_size_of(const struct pq_node *n)
+{
+	return n ? n->size : 0;
+}
+
+static inline int __pq_less(struct pq_root *root,
+const struct pq_node *a, const struct pq_node *b)
+{
+	int diff = root->cmp(a, b, root->arg);
+
+	if (diff == 0)
+		return a->seq < b->seq;
+
+	return diff < 0;
+}
+
+/* xorshift32; deterministic so runs are reproducible */
+static inline unsigned int __pq_random(struct pq_root *root)
+{
+	unsigned int x = root->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	return root->rng = x;
+}
+
+/*
+* Rotate @x above its parent, keeping subtree sizes correct.
+*/
+static inline void __pq_rotate_up(struct pq_root *root, struct pq_node *x)
+{
+	struct pq_node *p = x->parent;
+	struct pq_node *g = p->parent;
+
+	if (p->left == x) {
+		p->left = x->right;
+		if (x->right)
+			x->right->parent = p;
+		x->right = p;
+	} else {
+		p->right = x->left;
+		if (x->left)
+			x->left->parent = p;
+		x->left = p;
+	}
+
+	p->parent = x;
+	x->parent = g;
+
+	if (g == 0)
+		root->root = x;
+	else if (g->left == p)
+		g->left = x;
+	else
+		g->right = x;
+
+	x->size = p->size;
+	p->size = 1 + __pq_size_of(p->left) + __pq_size_of(p->right);
+}
+
+/*
+* Link a node that already has its seq and prio into the tree.
+* Returns the node's index.
+*/
+static inline int __pq_link(struct pq_node *node, struct pq_root *root)
+{
+	struct pq_node *parent = 0;
+	struct pq_node *n = root->root;
+	int index = 0;
+
+	node->size = 1;
+	node->left = node->right = 0;
+
+	/* walk down to the leaf position, counting what precedes it */
+	while (n) {
+		parent = n;
+		n->size++;
+
+		if (__pq_less(root, node, n)) {
+			n = n->left;
+		} else {
+			index += __pq_size_of(n->left) + 1;
+			n = n->right;
+		}
+	}
+
+	node->parent = parent;
+
+	if (parent == 0)
+		root->root = node;
+	else if (__pq_less(root, node, parent))
+		parent->left = node;
+	else
+		parent->right = node;
+
+	/* restore the heap order on priorities */
+	while (node->parent && node->prio < node->parent->prio)
+		__pq_rotate_up(root, node);
+
+	return index;
+}
+
+/*
+* Rotate a node down to a leaf and cut it off, leaving it unqueued.
+*/
+static inline void __pq_unlink(struct pq_node *node, struct pq_root *root)
+{
+	struct pq_node *p;
+
+	while (node->left || node->right) {
+		struct pq_node *c;
+
+		if (node->left == 0)
+			c = node->right;
+		else if (node->right == 0)
+			c = node->left;
+		else
+			c = node->left->prio < node->right->prio ? node->left : node->right;
+
+		__pq_rotate_up(root, c);
+	}
+
+	p = node->parent;
+
+	if (p == 0)
+		root->root = 0;
+	else if (p->left == node)
+		p->left = 0;
+	else
+		p->right = 0;
+
+	for (; p; p = p->parent)
+		p->size--;
+}
+
+/**
+* pq_insert - add a node to the queue
+* @node: the node to add
+* @root: the queue
+*
+* Nodes that compare equal stay in insertion (FIFO) order.
+* Returns the zero-based index the node landed at.
+*/
+static inline int pq_insert(struct pq_node *node, struct pq_root *root)
+{
+	node->seq = root->next_seq++;
+	node->prio = __pq_random(root);
+
+	return __pq_link(node, root);
+}
+
+/**
+* pq_erase - remove a node from the queue
+* @node: the node to remove
+* @root: the queue
+*
+* The node is left as pq_node_init() leaves it, not queued.
+*/
+static inline void pq_erase(struct pq_node *node, struct pq_root *root)
+{
+	__pq_unlink(node, root);
+	pq_node_init(node);
+}
+
+/**
+* pq_update - restore order after a node's key changed
+* @node: the changed node
+* @root: the queue
+*
+* The node keeps its place among nodes that compare equal.
+*/
+static inline void pq_update(struct pq_node *node, struct pq_root *root)
+{
+	__pq_unlink(node, root);
+	__pq_link(node, root);
+}
+
+/**
+* pq_at - get the node at a position, or NULL if out of range
+* @root: the queue
+* @index: zero-based position in priority order
+*/
+static inline struct pq_node *pq_at(struct pq_root *root, int index)
+{
+	struct pq_node *n = root->root;
+
+	if (index < 0 || index >= pq_size(root))
+		return 0;
+
+	while (n) {
+		int left = __pq_size_of(n->left);
+
+		if (index < left) {
+			n = n->left;
+		} else if (index == left) {
+			return n;
+		} else {
+			index -= left + 1;
+			n = n->right;
+		}
+	}
+
+	return 0;
+}
+
+/**
+* pq_first - get the highest priority node, or NULL if empty
+* @root: the queue
+*/
+static inline struct pq_node *pq_first(struct pq_root *root)
+{
+	struct pq_node *n = root->root;
+
+	if (n)
+		while (n->left)
+			n = n->left;
+
+	return n;
+}
+
+/**
+* pq_next - get the node after @node in priority order, or NULL
+* @node: a queued node
+*/
+static inline struct pq_node *pq_next(struct pq_node *node)
+{
+	if (node->right) {
+		node = node->right;
+		while (node->left)
+			node = node->left;
+		return node;
+	}
+
+	while (node->parent && node->parent->right == node)
+		node = node->parent;
+
+	return node->parent;
+}
+
+/**
+* pq_entry - get the struct for this entry
+* @ptr:	the &struct pq_node pointer.
+* @type:	the type of the struct this is embedded in.
+* @member:	the name of the pq_node within the struct.
+*/
+#define pq_entry(ptr, type, member) \
+	((type *)((char *)(ptr)-(unsigned long)(&((type *)0)->member)))
+
+/**
+* pq_for_each	-	iterate over a queue in priority order
+* @pos:	the &struct pq_node to use as a loop counter.
+* @root:	the queue.
+*/
+#define pq_for_each(pos, root) \
+	for (pos = pq_first(root); pos; pos = pq_next(pos))
+
+/**
+* pq_for_each_entry	-	iterate over a queue of given type in priority order
+* @pos:	the type * to use as a loop counter.
+* @root:	the queue.
+* @member:	the name of the pq_node within the struct.
+*/
+#define pq_for_each_entry(pos, root, member)				\
+	for (pos = pq_first(root) ? pq_entry(pq_first(root), typeof(*pos), member) : 0; \
+	     pos;							\
+	     pos = pq_next(&pos->member) ?				\
+		pq_entry(pq_next(&pos->member), typeof(*pos), member) : 0)
+
+
+#endif
@@ -0,0 +1,272 @@
+/** @file priqueue.hpp
+ */
+
+#ifndef PRIQUEUE_HPP_
+#define PRIQUEUE_HPP_
+
+#include <vector>
+#include <cstddef>
+
+#include "priqueue_shim.h"
+
+/**
+  Header-only binary heap with the priqueue_t operations, ordered by a
+  comparator known at compile time.
+
+  Compare is a function object with the same contract as a priqueue_t
+  comparer: int operator()(const T &a, const T &b) returning <0, 0 or >0.
+  Because its type is a template argument, the compiler can inline it into
+  the sift loops instead of calling through a function pointer. Equal
+  elements leave in FIFO order, like every libpriqueue backend.
+
+  With gcc, build users with -fno-if-conversion -fno-if-conversion2:
+  otherwise the inlined comparisons become conditional moves, and on heaps
+  larger than the cache each level's load waits on the previous miss.
+*/
+template <typename T, typename Compare>
+class PriQueue
+{
+public:
+	explicit PriQueue(Compare cmp = Compare()) : cmp_(cmp), next_seq_(0) {}
+
+	/** Inserts value; returns its heap position (0 means it is the head). */
+	int offer(const T &value)
+	{
+		Entry e = { value, next_seq_++ };
+		heap_.push_back(e);
+
+		return sift_up(heap_.size() - 1);
+	}
+
+	/** Returns the head without removing it, or T() if empty. */
+	T peek() const
+	{
+		return heap_.empty() ? T() : heap_[0].value;
+	}
+
+	/** Removes and returns the head, or T() if empty. */
+	T poll()
+	{
+		return heap_.empty() ? T() : erase(0);
+	}
+
+	/** Returns the index'th element in priority order, or T() if out of range. */
+	T at(int index)
+	{
+		int pos = select(index);
+
+		return pos < 0 ? T() : heap_[pos].value;
+	}
+
+	/** Removes every element equal (==) to value; returns how many. */
+	int remove(const T &value)
+	{
+		size_t kept = 0;
+
+		for (size_t i = 0; i < heap_.size(); i++)
+			if (!(heap_[i].value == value))
+				heap_[kept++] = heap_[i];
+
+		int removed = heap_.size() - kept;
+		heap_.resize(kept);
+
+		if (removed > 0)
+			for (int i = (int) kept / 2 - 1; i >= 0; i--)
+				sift_down(i);
+
+		return removed;
+	}
+
+	/** Removes and returns the index'th element, or T() if out of range. */
+	T remove_at(int index)
+	{
+		int pos = select(index);
+
+		return pos < 0 ? T() : erase(pos);
+	}
+
+	int size() const
+	{
+		return heap_.size();
+	}
+
+private:
+	struct Entry
+	{
+		T value;
+		unsigned long seq;
+	};
+
+	bool less(const Entry &a, const Entry &b) const
+	{
+		int diff = cmp_(a.value, b.value);
+
+		return diff == 0 ? a.seq < b.seq : diff < 0;
+	}
+
+	int sift_up(size_t pos)
+	{
+		Entry e = heap_[pos];
+
+		while (pos > 0) {
+			size_t parent = (pos - 1) / 2;
+
+			if (!less(e, heap_[parent]))
+				break;
+
+			heap_[pos] = heap_[parent];
+			pos = parent;
+		}
+
+		heap_[pos] = e;
+
+		return pos;
+	}
+
+	void sift_down(size_t pos)
+	{
+		Entry e = heap_[pos];
+		size_t n = heap_.size();
+
+		while (true) {
+			size_t child = 2 * pos + 1;
+
+			if (child >= n)
+				break;
+
+			if (child + 1 < n && less(heap_[child + 1], heap_[child]))
+				child++;
+
+			if (!less(heap_[child], e))
+				break;
+
+			heap_[pos] = heap_[child];
+			pos = child;
+		}
+
+		heap_[pos] = e;
+	}
+
+	T erase(size_t pos)
+	{
+		T value = heap_[pos].value;
+
+		heap_[pos] = heap_.back();
+		heap_.pop_back();
+
+		if (pos < heap_.size()) {
+			if (pos > 0 && less(heap_[pos], heap_[(pos - 1) / 2]))
+				sift_up(pos);
+			else
+				sift_down(pos);
+		}
+
+		return value;
+	}
+
+	/* Best-first walk of the heap, O(index log index); see priqueue_heap.c. */
+	int select(int index)
+	{
+		if (index < 0 || index >= (int) heap_.size())
+			return -1;
+
+		scratch_.clear();
+		scratch_.push_back(0);
+
+		for (int i = 0; ; i++) {
+			int top = scratch_[0];
+
+			if (i == index)
+				return top;
+
+			scratch_[0] = scratch_.back();
+			scratch_.pop_back();
+			cand_sift_down();
+
+			for (size_t c = 2 * top + 1; c <= (size_t) 2 * top + 2 && c < heap_.size(); c++) {
+				scratch_.push_back(c);
+				cand_sift_up(scratch_.size() - 1);
+			}
+		}
+	}
+
+	void cand_sift_up(size_t pos)
+	{
+		int c = scratch_[pos];
+
+		while (pos > 0 && less(heap_[c], heap_[scratch_[(pos - 1) / 2]])) {
+			scratch_[pos] = scratch_[(pos - 1) / 2];
+			pos = (pos - 1) / 2;
+		}
+
+		scratch_[pos] = c;
+	}
+
+	void cand_sift_down()
+	{
+		size_t n = scratch_.size(), pos = 0;
+
+		if (n == 0)
+			return;
+
+		int c = scratch_[0];
+
+		while (true) {
+			size_t child = 2 * pos + 1;
+
+			if (child >= n)
+				break;
+
+			if (child + 1 < n && less(heap_[scratch_[child + 1]], heap_[scratch_[child]]))
+				child++;
+
+			if (!less(heap_[scratch_[child]], heap_[c]))
+				break;
+
+			scratch_[pos] = scratch_[child];
+			pos = child;
+		}
+
+		scratch_[pos] = c;
+	}
+
+	Compare cmp_;
+	unsigned long next_seq_;
+	std::vector<Entry> heap_;
+	std::vector<int> scratch_;
+};
+
+
+/**
+  Turns an existing C comparer into a compile-time comparator, so any
+  priqueue_t comparer can be specialized without rewriting it. The
+  comparer's definition must be visible (e.g. static inline in a header)
+  for the call to be inlined.
+*/
+template <int (*F)(const void *, const void *)>
+struct CompareFn
+{
+	int operator()(void *a, void *b) const
+	{
+		return F(a, b);
+	}
+};
+
+
+/**
+  Defines the C functions declared by PRIQUEUE_SHIM_DECLARE(name) for a
+  PriQueue<void *, Compare>. Use it in exactly one C++ source file.
+*/
+#define PRIQUEUE_SHIM_DEFINE(name, Compare) \
+	struct name##_s : PriQueue<void *, Compare > {}; \
+	extern "C" name##_t *name##_create(void) { return new name##_s(); } \
+	extern "C" void  name##_destroy(name##_t *q) { delete q; } \
+	extern "C" int   name##_offer(name##_t *q, void *ptr) { return q->offer(ptr); } \
+	extern "C" void *name##_peek(name##_t *q) { return q->peek(); } \
+	extern "C" void *name##_poll(name##_t *q) { return q->poll(); } \
+	extern "C" void *name##_at(name##_t *q, int index) { return q->at(index); } \
+	extern "C" int   name##_remove(name##_t *q, void *ptr) { return q->remove(ptr); } \
+	extern "C" void *name##_remove_at(name##_t *q, int index) { return q->remove_at(index); } \
+	extern "C" int   name##_size(name##_t *q) { return q->size(); }
+
+#endif /* PRIQUEUE_HPP_ */
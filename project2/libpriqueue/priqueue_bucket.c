@@ -0,0 +1,392 @@
+/** @file priqueue_bucket.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Bucket queue backend, for elements whose order is mostly decided by a
+  small integer key.
+
+  There is one doubly linked list per key in [min_key, max_key]; keys
+  outside the range share the first or last bucket. Each list is kept
+  sorted by the comparer, inserting from its tail, so elements offered
+  in order (the usual case when the comparer only breaks ties by arrival)
+  are appended in O(1) and equal elements keep FIFO order. A bitmap of
+  non-empty buckets finds the front in O(buckets / 64).
+
+  The key must agree with the comparer: whenever cmp(a, b) < 0,
+  key(a) <= key(b). Then every operation gives the same results as the
+  other backends.
+ */
+typedef struct _bucket_node_t
+{
+	void *data;
+	struct _bucket_node_t *prev, *next;
+	int bucket;
+} bucket_node_t;
+
+typedef struct _bucket_list_t
+{
+	bucket_node_t *head, *tail;
+	int count;
+} bucket_list_t;
+
+typedef struct _bucket_t
+{
+	int(*key)(const void *);
+	int min_key, num_buckets;
+	bucket_list_t *buckets;
+	unsigned long long *nonempty;
+	int count;
+} bucket_t;
+
+
+static void bucket_init(priqueue_t *q)
+{
+	bucket_t *b = malloc(sizeof(bucket_t));
+
+	// the buckets are added by priqueue_bucket_set_range()
+	b->key = NULL;
+	b->min_key = 0;
+	b->num_buckets = 0;
+	b->buckets = NULL;
+	b->nonempty = NULL;
+	b->count = 0;
+
+	q->impl = b;
+	priqueue_pool_init(&q->pool, sizeof(bucket_node_t));
+}
+
+
+static int bucket_of(bucket_t *b, const void *ptr)
+{
+	int i = b->key(ptr) - b->min_key;
+
+	if(i < 0)
+		return 0;
+	if(i >= b->num_buckets)
+		return b->num_buckets - 1;
+
+	return i;
+}
+
+
+/**
+  Index of the first non-empty bucket at or after from, or -1.
+ */
+static int bucket_first(bucket_t *b, int from)
+{
+	int words = (b->num_buckets + 63) / 64;
+	int w = from / 64;
+
+	if(w >= words)
+		return -1;
+
+	unsigned long long bits = b->nonempty[w] & (~0ULL << (from % 64));
+
+	while(bits == 0) {
+		if(++w == words)
+			return -1;
+		bits = b->nonempty[w];
+	}
+
+	return w * 64 + __builtin_ctzll(bits);
+}
+
+
+/**
+  Links n into its bucket after every element that does not compare
+  greater, and returns its position within the bucket.
+ */
+static int bucket_link(priqueue_t *q, bucket_node_t *n)
+{
+	bucket_t *b = q->impl;
+	int i = bucket_of(b, n->data);
+	bucket_list_t *list = &b->buckets[i];
+	bucket_node_t *prev = list->tail;
+	int index = list->count;
+
+	//walk back from the tail; in-order offers stop at once
+	while(prev != NULL && PRIQUEUE_CMP(q, n->data, prev->data) < 0) {
+		PRIQUEUE_COUNT(q, hops);
+		prev = prev->prev;
+		index--;
+	}
+
+	n->bucket = i;
+	n->prev = prev;
+	n->next = prev ? prev->next : list->head;
+
+	if(n->next)
+		n->next->prev = n;
+	else
+		list->tail = n;
+
+	if(prev)
+		prev->next = n;
+	else
+		list->head = n;
+
+	list->count++;
+	b->count++;
+	b->nonempty[i / 64] |= 1ULL << (i % 64);
+
+	return index;
+}
+
+
+static void bucket_unlink(priqueue_t *q, bucket_node_t *n)
+{
+	bucket_t *b = q->impl;
+	bucket_list_t *list = &b->buckets[n->bucket];
+
+	if(n->prev)
+		n->prev->next = n->next;
+	else
+		list->head = n->next;
+
+	if(n->next)
+		n->next->prev = n->prev;
+	else
+		list->tail = n->prev;
+
+	list->count--;
+	b->count--;
+
+	if(list->count == 0)
+		b->nonempty[n->bucket / 64] &= ~(1ULL << (n->bucket % 64));
+}
+
+
+static int bucket_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	bucket_node_t *n = priqueue_node_new(q, ptr);
+
+	if(n == NULL)
+		return -1;
+
+	n->data = ptr;
+
+	if(handle)
+		*handle = (priqueue_handle_t) n;
+
+	return bucket_link(q, n);
+}
+
+
+static bucket_node_t *bucket_front(priqueue_t *q)
+{
+	bucket_t *b = q->impl;
+	int i = bucket_first(b, 0);
+
+	return i == -1 ? NULL : b->buckets[i].head;
+}
+
+
+static void *bucket_peek(priqueue_t *q)
+{
+	bucket_node_t *n = bucket_front(q);
+
+	return n ? n->data : NULL;
+}
+
+
+static void *bucket_poll(priqueue_t *q)
+{
+	bucket_node_t *n = bucket_front(q);
+
+	if(n == NULL)
+		return NULL;
+
+	void *value = n->data;
+
+	bucket_unlink(q, n);
+	priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+/**
+  Skips whole buckets by their counts, then walks the one holding index.
+ */
+static bucket_node_t *bucket_node_at(priqueue_t *q, int index)
+{
+	bucket_t *b = q->impl;
+
+	if(index < 0 || index >= b->count)
+		return NULL;
+
+	for(int i = bucket_first(b, 0); i != -1; i = bucket_first(b, i + 1)) {
+		if(index < b->buckets[i].count) {
+			bucket_node_t *n = b->buckets[i].head;
+
+			while(index-- > 0)
+				n = n->next;
+
+			return n;
+		}
+
+		index -= b->buckets[i].count;
+	}
+
+	return NULL;
+}
+
+
+static void *bucket_at(priqueue_t *q, int index)
+{
+	bucket_node_t *n = bucket_node_at(q, index);
+
+	return n ? n->data : NULL;
+}
+
+
+static void *bucket_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	bucket_node_t *n = (bucket_node_t *) handle;
+	void *value = n->data;
+
+	bucket_unlink(q, n);
+	priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+static void *bucket_remove_at(priqueue_t *q, int index)
+{
+	bucket_node_t *n = bucket_node_at(q, index);
+
+	if(n == NULL)
+		return NULL;
+
+	return bucket_remove_handle(q, (priqueue_handle_t) n);
+}
+
+
+static void bucket_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	bucket_node_t *n = (bucket_node_t *) handle;
+
+	bucket_unlink(q, n);
+	bucket_link(q, n);
+}
+
+
+static int bucket_size(priqueue_t *q)
+{
+	bucket_t *b = q->impl;
+
+	return b->count;
+}
+
+
+/**
+  Node after n in queue order, moving on to the next non-empty bucket.
+ */
+static bucket_node_t *bucket_successor(bucket_t *b, bucket_node_t *n)
+{
+	if(n->next != NULL)
+		return n->next;
+
+	int i = bucket_first(b, n->bucket + 1);
+
+	return i == -1 ? NULL : b->buckets[i].head;
+}
+
+
+static void *bucket_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	bucket_node_t *n = bucket_front(q);
+
+	it->current = (priqueue_handle_t) n;
+
+	return n ? n->data : NULL;
+}
+
+
+static void *bucket_iter_next(priqueue_iter_t *it)
+{
+	bucket_node_t *n = (bucket_node_t *) it->current;
+
+	if(n != NULL)
+		n = bucket_successor(it->q->impl, n);
+	else
+		n = (bucket_node_t *) it->next;	//current was removed
+
+	it->current = (priqueue_handle_t) n;
+
+	return n ? n->data : NULL;
+}
+
+
+static void *bucket_iter_remove(priqueue_iter_t *it)
+{
+	bucket_node_t *n = (bucket_node_t *) it->current;
+
+	it->next = (priqueue_handle_t) bucket_successor(it->q->impl, n);
+
+	return bucket_remove_handle(it->q, it->current);
+}
+
+
+static void bucket_destroy(priqueue_t *q)
+{
+	bucket_t *b = q->impl;
+
+	//the nodes go back with the pool's slabs
+	free(b->buckets);
+	free(b->nonempty);
+	free(b);
+	q->impl = NULL;
+}
+
+
+/**
+  Sets the key function and the range of keys that get a bucket each.
+ */
+void priqueue_bucket_set_range(priqueue_t *q, int(*key)(const void *), int min_key, int max_key)
+{
+	bucket_t *b = q->impl;
+
+	if(max_key < min_key)
+		max_key = min_key;
+
+	b->key = key;
+	b->min_key = min_key;
+	b->num_buckets = max_key - min_key + 1;
+	b->buckets = calloc(b->num_buckets, sizeof(bucket_list_t));
+	b->nonempty = calloc((b->num_buckets + 63) / 64, sizeof(unsigned long long));
+}
+
+
+const priqueue_ops_t priqueue_bucket_ops =
+{
+	bucket_init,
+	bucket_offer,
+	NULL,
+	bucket_peek,
+	bucket_poll,
+	NULL,
+	NULL,
+	bucket_at,
+	bucket_remove_at,
+	bucket_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	bucket_update,
+	bucket_size,
+	bucket_iter_begin,
+	bucket_iter_next,
+	bucket_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	bucket_destroy
+};
@@ -0,0 +1,748 @@
+/** @file priqueue_concurrent.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "priqueue_internal.h"
+
+#define CONC_MAX_LEVEL    24
+#define CONC_BOUND_OFFSET 32	// deleted nodes left at the front before they are unlinked
+
+
+/**
+  Linearizable lock-free priority queue, for queues shared between threads.
+
+  A skiplist after Linden and Jonsson, "A Skiplist-Based Concurrent Priority
+  Queue with Minimal Memory Contention" (OPODIS 2013). Poll never unlinks
+  the node it takes: it sets the low bit of its predecessor's level 0 next
+  pointer with one fetch-and-or, which deletes whatever node currently
+  follows. Deleted nodes therefore form a prefix of the list, and an
+  insert (a CAS on an unmarked level 0 pointer) can never land inside it.
+  Once the prefix is CONC_BOUND_OFFSET nodes long, one poll swings the head
+  past it with a single CAS and retires those nodes.
+
+  Elements leave the queue through exactly one transition of their node's
+  state: LIVE to TAKEN by a poll, or LIVE to DEAD by priqueue_remove and
+  friends. A DEAD node stays linked until polls sweep it into the prefix.
+
+  Retired nodes are freed with epoch-based reclamation: every operation
+  runs inside a critical section that publishes the global epoch it saw,
+  and a node retired in epoch e is freed once the epoch reaches e + 2, when
+  no thread can still be looking at it. Each thread that touches the queue
+  gets a record, kept until the queue is destroyed.
+
+  Ties between equal elements are broken by an insertion ticket, so they
+  leave in the order their offers were linearized.
+ */
+enum { CONC_LIVE, CONC_TAKEN, CONC_DEAD };
+
+struct conc_node
+{
+	void *data;
+	unsigned long seq;
+	int level;
+	atomic_int state;
+	atomic_int inserting;
+
+	unsigned long retired_epoch;
+	struct conc_node *retired_next;
+
+	_Atomic uintptr_t next[];	// low bit of next[0] set: the next node is deleted
+};
+
+typedef struct _conc_thread
+{
+	pthread_t owner;
+	atomic_ulong epoch;	// (epoch << 1) | 1 while inside an operation, 0 outside
+	int depth;
+
+	struct conc_node *retired, *retired_tail;
+	struct _conc_thread *next;
+} conc_thread_t;
+
+typedef struct _conc_t
+{
+	struct conc_node *head;
+	atomic_int count;
+	atomic_ulong next_seq;
+
+	atomic_ulong epoch;
+	_Atomic(conc_thread_t *) threads;
+	unsigned long id;
+} conc_t;
+
+static atomic_ulong conc_next_id = 1;
+
+static __thread unsigned long cached_id;
+static __thread conc_thread_t *cached_thread;
+static __thread unsigned int level_rng;
+
+
+#define is_marked(p)  ((p) & 1)
+#define unmarked(p)   ((struct conc_node *)((p) & ~(uintptr_t) 1))
+
+
+static int node_less(priqueue_t *q, const struct conc_node *a, const struct conc_node *b)
+{
+	int diff = PRIQUEUE_CMP(q, a->data, b->data);
+
+	if(diff == 0)
+		return a->seq < b->seq;
+
+	return diff < 0;
+}
+
+
+static int next_deleted(struct conc_node *n)
+{
+	return is_marked(atomic_load(&n->next[0]));
+}
+
+
+static struct conc_node *node_new(int level)
+{
+	struct conc_node *n = malloc(sizeof(struct conc_node) + level * sizeof(_Atomic uintptr_t));
+
+	if(n == NULL)
+		return NULL;
+
+	n->level = level;
+	atomic_init(&n->state, CONC_LIVE);
+	atomic_init(&n->inserting, 0);
+	n->retired_next = NULL;
+
+	for(int i = 0; i < level; i++)
+		atomic_init(&n->next[i], 0);
+
+	return n;
+}
+
+
+static int random_level()
+{
+	if(level_rng == 0)
+		level_rng = (unsigned int)(uintptr_t) &level_rng | 1;
+
+	level_rng ^= level_rng << 13;
+	level_rng ^= level_rng >> 17;
+	level_rng ^= level_rng << 5;
+
+	int level = 1;
+	unsigned int bits = level_rng;
+
+	while((bits & 1) && level < CONC_MAX_LEVEL) {
+		bits >>= 1;
+		level++;
+	}
+
+	return level;
+}
+
+
+/**
+  Finds the calling thread's record, adding one on its first visit.
+ */
+static conc_thread_t *thread_record(conc_t *c)
+{
+	if(cached_id == c->id)
+		return cached_thread;
+
+	pthread_t self = pthread_self();
+	conc_thread_t *t;
+
+	for(t = atomic_load(&c->threads); t != NULL; t = t->next)
+		if(pthread_equal(t->owner, self))
+			break;
+
+	if(t == NULL) {
+		t = malloc(sizeof(conc_thread_t));
+		t->owner = self;
+		atomic_init(&t->epoch, 0);
+		t->depth = 0;
+		t->retired = t->retired_tail = NULL;
+
+		t->next = atomic_load(&c->threads);
+		while(!atomic_compare_exchange_weak(&c->threads, &t->next, t))
+			;
+	}
+
+	cached_id = c->id;
+	cached_thread = t;
+
+	return t;
+}
+
+
+static conc_thread_t *conc_enter(conc_t *c)
+{
+	conc_thread_t *t = thread_record(c);
+
+	if(t->depth++ == 0)
+		atomic_store(&t->epoch, (atomic_load(&c->epoch) << 1) | 1);
+
+	return t;
+}
+
+
+static void conc_exit(conc_thread_t *t)
+{
+	if(--t->depth == 0)
+		atomic_store(&t->epoch, 0);
+}
+
+
+/**
+  Moves the global epoch on if every thread inside an operation has seen
+  the current one, then frees this thread's nodes retired two epochs ago.
+ */
+static void conc_reclaim(conc_t *c, conc_thread_t *self)
+{
+	unsigned long epoch = atomic_load(&c->epoch);
+	conc_thread_t *t;
+
+	for(t = atomic_load(&c->threads); t != NULL; t = t->next) {
+		unsigned long seen = atomic_load(&t->epoch);
+
+		if((seen & 1) && (seen >> 1) != epoch)
+			break;
+	}
+
+	if(t == NULL && atomic_compare_exchange_strong(&c->epoch, &epoch, epoch + 1))
+		epoch++;
+
+	while(self->retired != NULL && self->retired->retired_epoch + 2 <= epoch) {
+		struct conc_node *n = self->retired;
+
+		self->retired = n->retired_next;
+		free(n);
+	}
+
+	if(self->retired == NULL)
+		self->retired_tail = NULL;
+}
+
+
+static void conc_retire(conc_t *c, conc_thread_t *t, struct conc_node *n)
+{
+	n->retired_epoch = atomic_load(&c->epoch);
+	n->retired_next = NULL;
+
+	if(t->retired_tail)
+		t->retired_tail->retired_next = n;
+	else
+		t->retired = n;
+	t->retired_tail = n;
+}
+
+
+/**
+  Finds the predecessors and successors of key on every level, passing over
+  the deleted prefix.
+
+  @return the last deleted node seen on level 0, or NULL
+ */
+static struct conc_node *locate_preds(priqueue_t *q, struct conc_node *key, struct conc_node **preds, struct conc_node **succs)
+{
+	conc_t *c = q->impl;
+	struct conc_node *x = c->head, *x_next, *del = NULL;
+
+	for(int i = CONC_MAX_LEVEL - 1; i >= 0; i--) {
+		int d = next_deleted(x);
+		x_next = unmarked(atomic_load(&x->next[i]));
+
+		while(x_next != NULL && (node_less(q, x_next, key) || next_deleted(x_next) || (i == 0 && d))) {
+			if(i == 0 && d)
+				del = x_next;
+
+			x = x_next;
+			d = next_deleted(x);
+			x_next = unmarked(atomic_load(&x->next[i]));
+		}
+
+		preds[i] = x;
+		succs[i] = x_next;
+	}
+
+	return del;
+}
+
+
+/**
+  Links n, whose data, seq and level are set, into the skiplist.
+
+  @return 0 if n became the first element, 1 otherwise
+ */
+static int conc_link(priqueue_t *q, struct conc_node *n)
+{
+	conc_t *c = q->impl;
+	struct conc_node *preds[CONC_MAX_LEVEL], *succs[CONC_MAX_LEVEL], *del;
+	uintptr_t expected;
+
+	atomic_store(&n->inserting, 1);
+
+	//level 0 decides membership
+	do {
+		del = locate_preds(q, n, preds, succs);
+		atomic_store(&n->next[0], (uintptr_t) succs[0]);
+		expected = (uintptr_t) succs[0];
+	} while(!atomic_compare_exchange_strong(&preds[0]->next[0], &expected, (uintptr_t) n));
+
+	int front = (preds[0] == c->head || preds[0] == del);
+
+	//the upper levels are only shortcuts; give up if n or its successor is being deleted
+	for(int i = 1; i < n->level; ) {
+		atomic_store(&n->next[i], (uintptr_t) succs[i]);
+
+		if(next_deleted(n) || (succs[i] != NULL && next_deleted(succs[i])) || (del != NULL && del == succs[i]))
+			break;
+
+		expected = (uintptr_t) succs[i];
+		if(atomic_compare_exchange_strong(&preds[i]->next[i], &expected, (uintptr_t) n)) {
+			i++;
+		}
+		else {
+			del = locate_preds(q, n, preds, succs);
+			if(succs[0] != n)
+				break;
+		}
+	}
+
+	atomic_store(&n->inserting, 0);
+
+	return front ? 0 : 1;
+}
+
+
+/**
+  Unlinks the deleted prefix from the upper levels of the head.
+ */
+static void restructure(conc_t *c)
+{
+	struct conc_node *pred = c->head;
+
+	for(int i = CONC_MAX_LEVEL - 1; i > 0; ) {
+		uintptr_t h = atomic_load(&c->head->next[i]);
+
+		if(h == 0 || !next_deleted(unmarked(h))) {
+			i--;
+			continue;
+		}
+
+		struct conc_node *cur = unmarked(atomic_load(&pred->next[i]));
+		while(cur != NULL && next_deleted(cur)) {
+			pred = cur;
+			cur = unmarked(atomic_load(&pred->next[i]));
+		}
+
+		if(atomic_compare_exchange_strong(&c->head->next[i], &h, atomic_load(&pred->next[i])))
+			i--;
+	}
+}
+
+
+/**
+  Returns the first LIVE node at or after n on level 0, or NULL.
+ */
+static struct conc_node *first_live(struct conc_node *n)
+{
+	while(n != NULL && atomic_load(&n->state) != CONC_LIVE)
+		n = unmarked(atomic_load(&n->next[0]));
+
+	return n;
+}
+
+
+static struct conc_node *live_after_prefix(conc_t *c)
+{
+	struct conc_node *x = c->head;
+
+	while(next_deleted(x))
+		x = unmarked(atomic_load(&x->next[0]));
+
+	return first_live(unmarked(atomic_load(&x->next[0])));
+}
+
+
+static struct conc_node *live_at(conc_t *c, int index)
+{
+	struct conc_node *n = live_after_prefix(c);
+
+	if(index < 0)
+		return NULL;
+
+	for(int i = 0; n != NULL && i < index; i++)
+		n = first_live(unmarked(atomic_load(&n->next[0])));
+
+	return n;
+}
+
+
+/**
+  Takes n out of the queue unless a poll or another removal got it first.
+ */
+static void *conc_kill(conc_t *c, struct conc_node *n)
+{
+	int expected = CONC_LIVE;
+
+	if(!atomic_compare_exchange_strong(&n->state, &expected, CONC_DEAD))
+		return NULL;
+
+	atomic_fetch_sub(&c->count, 1);
+
+	return n->data;
+}
+
+
+static void conc_init(priqueue_t *q)
+{
+	conc_t *c = malloc(sizeof(conc_t));
+
+	c->head = node_new(CONC_MAX_LEVEL);
+	c->head->data = NULL;
+	c->head->seq = 0;
+	atomic_init(&c->count, 0);
+	atomic_init(&c->next_seq, 0);
+	atomic_init(&c->epoch, 0);
+	atomic_init(&c->threads, NULL);
+	c->id = atomic_fetch_add(&conc_next_id, 1);
+
+	q->impl = c;
+}
+
+
+static int conc_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	conc_t *c = q->impl;
+	struct conc_node *n = node_new(random_level());
+
+	if(n == NULL)
+		return -1;
+
+	n->data = ptr;
+	n->seq = atomic_fetch_add(&c->next_seq, 1);
+
+	if(handle)
+		*handle = (priqueue_handle_t) n;
+
+	//counted first, so a poll that takes it at once cannot make the size negative
+	atomic_fetch_add(&c->count, 1);
+
+	conc_thread_t *t = conc_enter(c);
+	int index = conc_link(q, n);
+	conc_exit(t);
+
+	return index;
+}
+
+
+static void *conc_peek(priqueue_t *q)
+{
+	conc_t *c = q->impl;
+	conc_thread_t *t = conc_enter(c);
+
+	struct conc_node *n = live_after_prefix(c);
+	void *value = n ? n->data : NULL;
+
+	conc_exit(t);
+
+	return value;
+}
+
+
+static void *conc_poll(priqueue_t *q)
+{
+	conc_t *c = q->impl;
+	conc_thread_t *t = conc_enter(c);
+
+	struct conc_node *x = c->head, *newhead = NULL;
+	uintptr_t obshead = atomic_load(&c->head->next[0]);
+	void *value = NULL;
+	int offset = 0, found = 0;
+
+	while(!found) {
+		uintptr_t next = atomic_load(&x->next[0]);
+
+		if(unmarked(next) == NULL)
+			break;
+
+		//nodes still linking their upper levels must not be freed yet
+		if(newhead == NULL && atomic_load(&x->inserting))
+			newhead = x;
+
+		if(!is_marked(next))
+			next = atomic_fetch_or(&x->next[0], 1);
+
+		offset++;
+		x = unmarked(next);
+
+		//the node after an unmarked pointer is ours; a removed one is skipped
+		if(!is_marked(next)) {
+			int expected = CONC_LIVE;
+
+			if(atomic_compare_exchange_strong(&x->state, &expected, CONC_TAKEN)) {
+				value = x->data;
+				atomic_fetch_sub(&c->count, 1);
+				found = 1;
+			}
+		}
+	}
+
+	//x is now the last deleted node; the head is swung to it, past the rest
+	if(found && offset >= CONC_BOUND_OFFSET) {
+		if(newhead == NULL)
+			newhead = x;
+
+		uintptr_t expected = obshead;
+
+		if(newhead != unmarked(obshead) &&
+		   atomic_compare_exchange_strong(&c->head->next[0], &expected, (uintptr_t) newhead | 1)) {
+			restructure(c);
+
+			struct conc_node *cur = unmarked(obshead);
+			while(cur != newhead) {
+				struct conc_node *next = unmarked(atomic_load(&cur->next[0]));
+				conc_retire(c, t, cur);
+				cur = next;
+			}
+
+			conc_reclaim(c, t);
+		}
+	}
+
+	conc_exit(t);
+
+	return value;
+}
+
+
+static void *conc_at(priqueue_t *q, int index)
+{
+	conc_t *c = q->impl;
+	conc_thread_t *t = conc_enter(c);
+
+	struct conc_node *n = live_at(c, index);
+	void *value = n ? n->data : NULL;
+
+	conc_exit(t);
+
+	return value;
+}
+
+
+static void *conc_remove_at(priqueue_t *q, int index)
+{
+	conc_t *c = q->impl;
+	conc_thread_t *t = conc_enter(c);
+	void *value = NULL;
+
+	//if another thread takes the node first, move on to the new index'th
+	struct conc_node *n;
+	while((n = live_at(c, index)) != NULL && (value = conc_kill(c, n)) == NULL)
+		;
+
+	conc_exit(t);
+
+	return value;
+}
+
+
+static void *conc_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	conc_t *c = q->impl;
+	conc_thread_t *t = conc_enter(c);
+
+	void *value = conc_kill(c, (struct conc_node *) handle);
+
+	conc_exit(t);
+
+	return value;
+}
+
+
+static priqueue_handle_t conc_find(priqueue_t *q, void *ptr)
+{
+	conc_t *c = q->impl;
+	struct conc_node *n;
+
+	for(n = live_after_prefix(c); n != NULL; n = first_live(unmarked(atomic_load(&n->next[0]))))
+		if(n->data == ptr)
+			break;
+
+	return (priqueue_handle_t) n;
+}
+
+
+/**
+  Looks up and removes in one critical section, since a handle found
+  outside one could be freed before it is used.
+ */
+static int conc_remove(priqueue_t *q, void *ptr)
+{
+	conc_t *c = q->impl;
+	conc_thread_t *t = conc_enter(c);
+	priqueue_handle_t handle;
+	int removed = 0;
+
+	while((handle = conc_find(q, ptr)) != NULL)
+		if(conc_kill(c, (struct conc_node *) handle) != NULL)
+			removed++;
+
+	conc_exit(t);
+
+	return removed;
+}
+
+
+/**
+  Not linearizable: the caller must make sure no other thread uses the
+  queue meanwhile. The node is unlinked by pointer on every level, O(n),
+  and linked again under its new key with its old ticket.
+ */
+static void conc_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	conc_t *c = q->impl;
+	struct conc_node *n = (struct conc_node *) handle;
+
+	assert(atomic_load(&n->state) == CONC_LIVE);
+
+	conc_thread_t *t = conc_enter(c);
+
+	for(int i = 0; i < n->level; i++) {
+		struct conc_node *pred = c->head;
+		struct conc_node *cur;
+
+		while((cur = unmarked(atomic_load(&pred->next[i]))) != NULL && cur != n)
+			pred = cur;
+
+		if(cur == n)
+			atomic_store(&pred->next[i], (atomic_load(&pred->next[i]) & 1) | (atomic_load(&n->next[i]) & ~(uintptr_t) 1));
+	}
+
+	for(int i = 0; i < n->level; i++)
+		atomic_store(&n->next[i], 0);
+
+	conc_link(q, n);
+
+	conc_exit(t);
+}
+
+
+static int conc_size(priqueue_t *q)
+{
+	conc_t *c = q->impl;
+
+	return atomic_load(&c->count);
+}
+
+
+/**
+  The cursor stays inside one critical section until priqueue_iter_end(),
+  so the node it stands on cannot be freed. It is weakly consistent: it
+  sees every element queued for the whole walk, and may or may not see
+  ones offered or removed meanwhile.
+ */
+static void *conc_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	conc_t *c = q->impl;
+
+	it->prev = conc_enter(c);
+
+	struct conc_node *n = live_after_prefix(c);
+	it->current = (priqueue_handle_t) n;
+
+	return n ? n->data : NULL;
+}
+
+
+static void *conc_iter_next(priqueue_iter_t *it)
+{
+	struct conc_node *n = (struct conc_node *) it->current;
+
+	if(n == NULL)
+		n = (struct conc_node *) it->next;
+
+	n = n ? first_live(unmarked(atomic_load(&n->next[0]))) : NULL;
+	it->current = (priqueue_handle_t) n;
+	it->next = NULL;
+
+	return n ? n->data : NULL;
+}
+
+
+static void *conc_iter_remove(priqueue_iter_t *it)
+{
+	//the node stays linked, so the walk carries on from it
+	it->next = it->current;
+
+	return conc_kill(it->q->impl, (struct conc_node *) it->current);
+}
+
+
+static void conc_iter_end(priqueue_iter_t *it)
+{
+	if(it->prev != NULL)
+		conc_exit(it->prev);
+	it->prev = NULL;
+}
+
+
+static void conc_destroy(priqueue_t *q)
+{
+	conc_t *c = q->impl;
+	struct conc_node *n = c->head;
+
+	while(n != NULL) {
+		struct conc_node *next = unmarked(atomic_load(&n->next[0]));
+		free(n);
+		n = next;
+	}
+
+	conc_thread_t *t = atomic_load(&c->threads);
+	while(t != NULL) {
+		conc_thread_t *next = t->next;
+
+		while(t->retired != NULL) {
+			struct conc_node *r = t->retired;
+			t->retired = r->retired_next;
+			free(r);
+		}
+
+		free(t);
+		t = next;
+	}
+
+	free(c);
+	q->impl = NULL;
+}
+
+
+const priqueue_ops_t priqueue_concurrent_ops =
+{
+	conc_init,
+	conc_offer,
+	NULL,
+	conc_peek,
+	conc_poll,
+	NULL,
+	NULL,
+	conc_at,
+	conc_remove_at,
+	conc_remove_handle,
+	conc_find,
+	conc_remove,
+	conc_update,
+	conc_size,
+	conc_iter_begin,
+	conc_iter_next,
+	conc_iter_remove,
+	conc_iter_end,
+	NULL,
+	NULL,
+	NULL,
+	conc_destroy
+};
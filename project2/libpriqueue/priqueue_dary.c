@@ -0,0 +1,427 @@
+/** @file priqueue_dary.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Cache-aligned 4-ary heap backend, for queues too large for the cache.
+
+  Sift-down in a binary heap loads a new cache line at every level, and
+  the levels below the cache are where the time goes. Here each node has
+  DARY_ARITY children, and the array is offset so every group of siblings
+  fills exactly one 64-byte line: a sift-down step reads all the children
+  with one miss and there are half as many levels. The comparer still
+  loads every child's element, so the gain is in the array's misses only.
+
+  An entry is just the element and its slot, 16 bytes. The slot records
+  the entry's position and serves as its handle, as in the heap backend,
+  and also keeps the insertion sequence number, which puts equal elements
+  in FIFO order; it is only read when the comparer returns 0.
+
+  priqueue_at, priqueue_remove_at and cursors drain a private binary heap
+  built from a copy of the array, O(n + index log n).
+ */
+#define DARY_ARITY 4
+#define DARY_LINE  64
+
+struct dary_slot
+{
+	int pos;
+	unsigned long seq;
+};
+
+struct dary_entry
+{
+	void *data;
+	struct dary_slot *slot;
+};
+
+typedef struct _dary_t
+{
+	struct dary_entry *entries;	// entries[1] starts a cache line
+	void *block;			// the allocation entries points into
+	int size, capacity;
+	unsigned long next_seq;
+} dary_t;
+
+
+static int dary_less(priqueue_t *q, const struct dary_entry *a, const struct dary_entry *b)
+{
+	int diff = PRIQUEUE_CMP(q, a->data, b->data);
+
+	if(diff == 0)
+		return a->slot->seq < b->slot->seq;
+
+	return diff < 0;
+}
+
+
+static void dary_place(dary_t *d, int pos, struct dary_entry e)
+{
+	d->entries[pos] = e;
+	e.slot->pos = pos;
+}
+
+
+static void dary_sift_up(priqueue_t *q, dary_t *d, int pos)
+{
+	struct dary_entry e = d->entries[pos];
+
+	while(pos > 0) {
+		int parent = (pos - 1) / DARY_ARITY;
+
+		if(!dary_less(q, &e, &d->entries[parent]))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		dary_place(d, pos, d->entries[parent]);
+		pos = parent;
+	}
+
+	dary_place(d, pos, e);
+}
+
+
+static void dary_sift_down(priqueue_t *q, dary_t *d, int pos)
+{
+	struct dary_entry e = d->entries[pos];
+
+	while(1) {
+		int first = DARY_ARITY * pos + 1;
+
+		if(first >= d->size)
+			break;
+
+		int last = first + DARY_ARITY < d->size ? first + DARY_ARITY : d->size;
+		int best = first;
+
+		for(int child = first + 1; child < last; child++)
+			if(dary_less(q, &d->entries[child], &d->entries[best]))
+				best = child;
+
+		if(!dary_less(q, &d->entries[best], &e))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		dary_place(d, pos, d->entries[best]);
+		pos = best;
+	}
+
+	dary_place(d, pos, e);
+}
+
+
+static void dary_fix(priqueue_t *q, dary_t *d, int pos)
+{
+	if(pos > 0 && dary_less(q, &d->entries[pos], &d->entries[(pos - 1) / DARY_ARITY]))
+		dary_sift_up(q, d, pos);
+	else
+		dary_sift_down(q, d, pos);
+}
+
+
+static void *dary_delete(priqueue_t *q, dary_t *d, int pos)
+{
+	void *value = d->entries[pos].data;
+
+	priqueue_node_release(q, value, d->entries[pos].slot);
+	d->size--;
+
+	if(pos != d->size) {
+		dary_place(d, pos, d->entries[d->size]);
+		dary_fix(q, d, pos);
+	}
+
+	return value;
+}
+
+
+/**
+  Moves the entries to a new array of capacity, laid out so entries[1],
+  and with it every group of siblings, starts a cache line. The root sits
+  alone at the end of the line before.
+ */
+static int dary_alloc(dary_t *d, int capacity)
+{
+	size_t lead = DARY_LINE - sizeof(struct dary_entry);
+	size_t bytes = lead + (size_t) capacity * sizeof(struct dary_entry);
+
+	//aligned_alloc wants a multiple of the alignment
+	void *block = aligned_alloc(DARY_LINE, (bytes + DARY_LINE - 1) / DARY_LINE * DARY_LINE);
+	if(block == NULL)
+		return 0;
+
+	struct dary_entry *entries = (struct dary_entry *)((char *) block + lead);
+
+	if(d->size > 0)
+		memcpy(entries, d->entries, d->size * sizeof(struct dary_entry));
+
+	free(d->block);
+	d->block = block;
+	d->entries = entries;
+	d->capacity = capacity;
+
+	return 1;
+}
+
+
+static void dary_init(priqueue_t *q)
+{
+	dary_t *d = malloc(sizeof(dary_t));
+
+	d->size = 0;
+	d->next_seq = 0;
+	d->block = NULL;
+	d->entries = NULL;
+	d->capacity = 0;
+
+	//if this runs out of memory the first offer tries again, and fails if it can not
+	dary_alloc(d, 16);
+
+	q->impl = d;
+	priqueue_pool_init(&q->pool, sizeof(struct dary_slot));
+}
+
+
+static int dary_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	dary_t *d = q->impl;
+
+	if(d->size == d->capacity && !dary_alloc(d, d->capacity ? 2 * d->capacity : 16))
+		return -1;
+
+	struct dary_slot *slot = priqueue_node_new(q, ptr);
+
+	if(slot == NULL)
+		return -1;
+
+	if(handle)
+		*handle = (priqueue_handle_t) slot;
+
+	slot->seq = d->next_seq++;
+
+	int pos = d->size++;
+	d->entries[pos].data = ptr;
+	d->entries[pos].slot = slot;
+
+	dary_sift_up(q, d, pos);
+
+	return slot->pos;
+}
+
+
+static void *dary_peek(priqueue_t *q)
+{
+	dary_t *d = q->impl;
+
+	return d->size ? d->entries[0].data : NULL;
+}
+
+
+static void *dary_poll(priqueue_t *q)
+{
+	dary_t *d = q->impl;
+
+	if(d->size == 0)
+		return NULL;
+
+	return dary_delete(q, d, 0);
+}
+
+
+static void order_sift_down(priqueue_t *q, struct dary_entry *order, int size, int pos)
+{
+	struct dary_entry e = order[pos];
+
+	while(1) {
+		int child = 2 * pos + 1;
+
+		if(child >= size)
+			break;
+
+		if(child + 1 < size && dary_less(q, &order[child + 1], &order[child]))
+			child++;
+
+		if(!dary_less(q, &order[child], &e))
+			break;
+
+		order[pos] = order[child];
+		pos = child;
+	}
+
+	order[pos] = e;
+}
+
+
+/**
+  Cursors drain a private binary heap built from a copy of the array,
+  which removals from the real heap leave alone.
+ */
+static void *dary_iter_next(priqueue_iter_t *it)
+{
+	struct dary_entry *order = it->order;
+
+	if(it->remaining == 0) {
+		it->current = NULL;
+		return NULL;
+	}
+
+	struct dary_entry top = order[0];
+
+	order[0] = order[--it->remaining];
+	order_sift_down(it->q, order, it->remaining, 0);
+
+	it->current = (priqueue_handle_t) top.slot;
+
+	return top.data;
+}
+
+
+static void *dary_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	dary_t *d = q->impl;
+
+	if(d->size == 0)
+		return NULL;
+
+	struct dary_entry *order = malloc(d->size * sizeof(struct dary_entry));
+	if(order == NULL) {
+		it->error = 1;
+		return NULL;
+	}
+
+	memcpy(order, d->entries, d->size * sizeof(struct dary_entry));
+
+	for(int pos = d->size / 2 - 1; pos >= 0; pos--)
+		order_sift_down(q, order, d->size, pos);
+
+	it->order = order;
+	it->remaining = d->size;
+
+	return dary_iter_next(it);
+}
+
+
+static void *dary_iter_remove(priqueue_iter_t *it)
+{
+	struct dary_slot *slot = (struct dary_slot *) it->current;
+
+	return dary_delete(it->q, it->q->impl, slot->pos);
+}
+
+
+/**
+  Array position of the index'th element, or -1.
+ */
+static int dary_select(priqueue_t *q, int index)
+{
+	dary_t *d = q->impl;
+	priqueue_iter_t it;
+	int pos;
+
+	if(index < 0 || index >= d->size)
+		return -1;
+
+	if(index == 0)
+		return 0;
+
+	it.q = q;
+	it.order = NULL;
+	it.current = NULL;
+
+	//the queue is not empty, so no first element means the copy failed
+	if(dary_iter_begin(q, &it) == NULL)
+		return -1;
+
+	for(int i = 0; i < index; i++)
+		dary_iter_next(&it);
+
+	pos = ((struct dary_slot *) it.current)->pos;
+	free(it.order);
+
+	return pos;
+}
+
+
+static void *dary_at(priqueue_t *q, int index)
+{
+	dary_t *d = q->impl;
+	int pos = dary_select(q, index);
+
+	return pos == -1 ? NULL : d->entries[pos].data;
+}
+
+
+static void *dary_remove_at(priqueue_t *q, int index)
+{
+	int pos = dary_select(q, index);
+
+	return pos == -1 ? NULL : dary_delete(q, q->impl, pos);
+}
+
+
+static void *dary_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct dary_slot *slot = (struct dary_slot *) handle;
+
+	return dary_delete(q, q->impl, slot->pos);
+}
+
+
+static void dary_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct dary_slot *slot = (struct dary_slot *) handle;
+
+	dary_fix(q, q->impl, slot->pos);
+}
+
+
+static int dary_size(priqueue_t *q)
+{
+	dary_t *d = q->impl;
+
+	return d->size;
+}
+
+
+static void dary_destroy(priqueue_t *q)
+{
+	dary_t *d = q->impl;
+
+	free(d->block);
+	free(d);
+
+	q->impl = NULL;
+}
+
+
+const priqueue_ops_t priqueue_dary_ops =
+{
+	dary_init,
+	dary_offer,
+	NULL,
+	dary_peek,
+	dary_poll,
+	NULL,
+	NULL,
+	dary_at,
+	dary_remove_at,
+	dary_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	dary_update,
+	dary_size,
+	dary_iter_begin,
+	dary_iter_next,
+	dary_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	dary_destroy
+};
@@ -0,0 +1,491 @@
+/** @file priqueue_heap.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Array-backed binary heap backend.
+
+  Each entry carries an insertion sequence number so elements that compare
+  equal leave the heap in FIFO order, matching the list backend.
+
+  The heap is indexed: every entry owns a slot from the queue's pool that
+  records the entry's current array position. Slots never move, so they
+  serve as the element's handle and let priqueue_update find it in O(1).
+ */
+struct heap_slot
+{
+	int pos;
+};
+
+struct heap_entry
+{
+	void *data;
+	unsigned long seq;
+	struct heap_slot *slot;
+};
+
+typedef struct _heap_t
+{
+	struct heap_entry *entries;
+	int size, capacity;
+	unsigned long next_seq;
+
+	int *scratch;       // candidate positions used by heap_select()
+	int scratch_capacity;
+} heap_t;
+
+
+static int heap_less(priqueue_t *q, const struct heap_entry *a, const struct heap_entry *b)
+{
+	int diff = PRIQUEUE_CMP(q, a->data, b->data);
+
+	if(diff == 0)
+		return a->seq < b->seq;
+
+	return diff < 0;
+}
+
+
+static int heap_sift_up(priqueue_t *q, heap_t *h, int pos)
+{
+	struct heap_entry e = h->entries[pos];
+
+	while(pos > 0) {
+		int parent = (pos - 1) / 2;
+
+		if(!heap_less(q, &e, &h->entries[parent]))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		h->entries[pos] = h->entries[parent];
+		h->entries[pos].slot->pos = pos;
+		pos = parent;
+	}
+
+	h->entries[pos] = e;
+	e.slot->pos = pos;
+
+	return pos;
+}
+
+
+static void heap_sift_down(priqueue_t *q, heap_t *h, int pos)
+{
+	struct heap_entry e = h->entries[pos];
+
+	while(1) {
+		int child = 2 * pos + 1;
+
+		if(child >= h->size)
+			break;
+
+		if(child + 1 < h->size && heap_less(q, &h->entries[child + 1], &h->entries[child]))
+			child++;
+
+		if(!heap_less(q, &h->entries[child], &e))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		h->entries[pos] = h->entries[child];
+		h->entries[pos].slot->pos = pos;
+		pos = child;
+	}
+
+	h->entries[pos] = e;
+	e.slot->pos = pos;
+}
+
+
+/**
+  Moves the entry at pos up or down until the heap property holds again.
+ */
+static void heap_fix(priqueue_t *q, heap_t *h, int pos)
+{
+	if(pos > 0 && heap_less(q, &h->entries[pos], &h->entries[(pos - 1) / 2]))
+		heap_sift_up(q, h, pos);
+	else
+		heap_sift_down(q, h, pos);
+}
+
+
+/**
+  Removes the entry at heap position pos and restores the heap property.
+ */
+static void *heap_delete(priqueue_t *q, heap_t *h, int pos)
+{
+	void *value = h->entries[pos].data;
+
+	priqueue_node_release(q, value, h->entries[pos].slot);
+	h->size--;
+
+	if(pos != h->size) {
+		h->entries[pos] = h->entries[h->size];
+		heap_fix(q, h, pos);
+	}
+
+	return value;
+}
+
+
+/**
+  Finds the heap position of the index'th element in priority order.
+
+  Walks the heap best-first with a small auxiliary heap of candidate
+  positions, so the cost is O(index log index) rather than a full sort.
+  @return the heap position, or -1 if index is out of range or the
+  candidate array could not grow
+ */
+static int heap_select(priqueue_t *q, heap_t *h, int index)
+{
+	if(index < 0 || index >= h->size)
+		return -1;
+
+	if(index == 0)
+		return 0;
+
+	// at most one candidate is popped and two pushed per step
+	if(h->scratch_capacity < index + 2) {
+		int *grown = realloc(h->scratch, (index + 2) * sizeof(int));
+
+		if(grown == NULL)
+			return -1;
+
+		h->scratch = grown;
+		h->scratch_capacity = index + 2;
+	}
+
+	int *cand = h->scratch;
+	int count = 1;
+	cand[0] = 0;
+
+	for(int i=0; ; i++) {
+		int top = cand[0];
+
+		if(i == index)
+			return top;
+
+		// pop the best candidate
+		int last = cand[--count];
+		int pos = 0;
+		while(1) {
+			int child = 2 * pos + 1;
+			if(child >= count)
+				break;
+			if(child + 1 < count && heap_less(q, &h->entries[cand[child + 1]], &h->entries[cand[child]]))
+				child++;
+			if(!heap_less(q, &h->entries[cand[child]], &h->entries[last]))
+				break;
+			cand[pos] = cand[child];
+			pos = child;
+		}
+		if(count > 0)
+			cand[pos] = last;
+
+		// push its children
+		for(int c = 2 * top + 1; c <= 2 * top + 2 && c < h->size; c++) {
+			pos = count++;
+			while(pos > 0 && heap_less(q, &h->entries[c], &h->entries[cand[(pos - 1) / 2]])) {
+				cand[pos] = cand[(pos - 1) / 2];
+				pos = (pos - 1) / 2;
+			}
+			cand[pos] = c;
+		}
+	}
+}
+
+
+static void heap_init(priqueue_t *q)
+{
+	heap_t *h = malloc(sizeof(heap_t));
+
+	//q->impl stays NULL, which priqueue_multiqueue_set_shards checks for
+	if(h == NULL)
+		return;
+
+	h->size = 0;
+	h->next_seq = 0;
+	h->entries = malloc(16 * sizeof(struct heap_entry));
+	//without an array the first offer tries again, and fails if it can not
+	h->capacity = h->entries ? 16 : 0;
+	h->scratch = NULL;
+	h->scratch_capacity = 0;
+
+	q->impl = h;
+	priqueue_pool_init(&q->pool, sizeof(struct heap_slot));
+}
+
+
+static int heap_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	heap_t *h = q->impl;
+
+	if(h->size == h->capacity) {
+		int capacity = h->capacity ? 2 * h->capacity : 16;
+		struct heap_entry *grown = realloc(h->entries, capacity * sizeof(struct heap_entry));
+
+		if(grown == NULL)
+			return -1;
+
+		h->entries = grown;
+		h->capacity = capacity;
+	}
+
+	struct heap_slot *slot = priqueue_node_new(q, ptr);
+
+	if(slot == NULL)
+		return -1;
+
+	if(handle)
+		*handle = (priqueue_handle_t) slot;
+
+	int pos = h->size++;
+	h->entries[pos].data = ptr;
+	h->entries[pos].seq = h->next_seq++;
+	h->entries[pos].slot = slot;
+
+	return heap_sift_up(q, h, pos);
+}
+
+
+/**
+  Appends the batch and restores the heap property. When the batch is at
+  least as large as the heap, Floyd's bottom-up heapify rebuilds it in
+  O(size + n); a small batch into a big heap is cheaper sifted up one by
+  one, O(n log size).
+ */
+static int heap_offer_batch(priqueue_t *q, void **ptrs, int n)
+{
+	heap_t *h = q->impl;
+	int old_size = h->size;
+
+	if(h->size + n > h->capacity) {
+		int capacity = h->capacity ? h->capacity : 16;
+		while(capacity < h->size + n)
+			capacity *= 2;
+
+		struct heap_entry *grown = realloc(h->entries, capacity * sizeof(struct heap_entry));
+
+		if(grown == NULL)
+			return 0;
+
+		h->entries = grown;
+		h->capacity = capacity;
+	}
+
+	for(int i = 0; i < n; i++) {
+		struct heap_slot *slot = priqueue_node_new(q, ptrs[i]);
+
+		if(slot == NULL)
+			break;
+
+		int pos = h->size++;
+		h->entries[pos].data = ptrs[i];
+		h->entries[pos].seq = h->next_seq++;
+		h->entries[pos].slot = slot;
+		slot->pos = pos;
+	}
+
+	if(h->size - old_size >= old_size) {
+		for(int pos = h->size / 2 - 1; pos >= 0; pos--)
+			heap_sift_down(q, h, pos);
+	}
+	else {
+		for(int pos = old_size; pos < h->size; pos++)
+			heap_sift_up(q, h, pos);
+	}
+
+	return h->size - old_size;
+}
+
+
+static void *heap_peek(priqueue_t *q)
+{
+	heap_t *h = q->impl;
+
+	if(h->size == 0)
+		return NULL;
+
+	return h->entries[0].data;
+}
+
+
+static void *heap_poll(priqueue_t *q)
+{
+	heap_t *h = q->impl;
+
+	if(h->size == 0)
+		return NULL;
+
+	return heap_delete(q, h, 0);
+}
+
+
+static void *heap_at(priqueue_t *q, int index)
+{
+	heap_t *h = q->impl;
+	int pos = heap_select(q, h, index);
+
+	if(pos == -1)
+		return NULL;
+
+	return h->entries[pos].data;
+}
+
+
+static void *heap_remove_at(priqueue_t *q, int index)
+{
+	heap_t *h = q->impl;
+	int pos = heap_select(q, h, index);
+
+	if(pos == -1)
+		return NULL;
+
+	return heap_delete(q, h, pos);
+}
+
+
+static void *heap_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct heap_slot *slot = (struct heap_slot *) handle;
+
+	return heap_delete(q, q->impl, slot->pos);
+}
+
+
+static void heap_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct heap_slot *slot = (struct heap_slot *) handle;
+
+	heap_fix(q, q->impl, slot->pos);
+}
+
+
+static int heap_size(priqueue_t *q)
+{
+	heap_t *h = q->impl;
+
+	return h->size;
+}
+
+
+/**
+  A heap is not stored in priority order, so the cursor drains a private
+  copy of the array: each step pops the copy's head, O(log n), and leaves
+  the queue itself alone. The copy's slots are never touched, so removing
+  the current element from the real heap does not disturb it.
+ */
+static void order_sift_down(priqueue_t *q, struct heap_entry *order, int size, int pos)
+{
+	struct heap_entry e = order[pos];
+
+	while(1) {
+		int child = 2 * pos + 1;
+
+		if(child >= size)
+			break;
+
+		if(child + 1 < size && heap_less(q, &order[child + 1], &order[child]))
+			child++;
+
+		if(!heap_less(q, &order[child], &e))
+			break;
+
+		order[pos] = order[child];
+		pos = child;
+	}
+
+	order[pos] = e;
+}
+
+
+static void *heap_iter_next(priqueue_iter_t *it)
+{
+	struct heap_entry *order = it->order;
+
+	if(it->remaining == 0) {
+		it->current = NULL;
+		return NULL;
+	}
+
+	struct heap_entry top = order[0];
+
+	order[0] = order[--it->remaining];
+	order_sift_down(it->q, order, it->remaining, 0);
+
+	it->current = (priqueue_handle_t) top.slot;
+
+	return top.data;
+}
+
+
+static void *heap_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	heap_t *h = q->impl;
+
+	if(h->size == 0)
+		return NULL;
+
+	it->order = malloc(h->size * sizeof(struct heap_entry));
+	if(it->order == NULL) {
+		it->error = 1;
+		return NULL;
+	}
+
+	memcpy(it->order, h->entries, h->size * sizeof(struct heap_entry));
+	it->remaining = h->size;
+
+	return heap_iter_next(it);
+}
+
+
+static void *heap_iter_remove(priqueue_iter_t *it)
+{
+	struct heap_slot *slot = (struct heap_slot *) it->current;
+
+	return heap_delete(it->q, it->q->impl, slot->pos);
+}
+
+
+static void heap_destroy(priqueue_t *q)
+{
+	heap_t *h = q->impl;
+
+	free(h->entries);
+	free(h->scratch);
+	free(h);
+
+	q->impl = NULL;
+}
+
+
+const priqueue_ops_t priqueue_heap_ops =
+{
+	heap_init,
+	heap_offer,
+	heap_offer_batch,
+	heap_peek,
+	heap_poll,
+	NULL,
+	NULL,
+	heap_at,
+	heap_remove_at,
+	heap_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	heap_update,
+	heap_size,
+	heap_iter_begin,
+	heap_iter_next,
+	heap_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	heap_destroy
+};
@@ -0,0 +1,231 @@
+/** @file priqueue_index.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+
+#define INDEX_MIN_CAPACITY 16
+
+
+/**
+  Hash index from element pointer to handle, used by priqueue_remove.
+
+  Open addressing with linear probing over a power-of-two table kept at
+  most half full. The same pointer may be queued more than once, so a key
+  can appear in several entries; each (pointer, handle) pair is unique.
+  Deletion shifts later entries back instead of leaving tombstones.
+  An entry is empty when its handle is NULL, since handles never are.
+ */
+static unsigned long index_hash(const priqueue_index_t *index, const void *ptr)
+{
+	// Fibonacci hashing; the low bits of pointers are mostly alignment
+	unsigned long long h = (unsigned long long)(unsigned long) ptr * 11400714819323198485ull;
+
+	return (unsigned long)(h >> 32) & (index->capacity - 1);
+}
+
+
+void priqueue_index_init(priqueue_index_t *index)
+{
+	index->entries = NULL;
+	index->capacity = 0;
+	index->count = 0;
+}
+
+
+static int index_grow(priqueue_index_t *index)
+{
+	priqueue_index_entry_t *old = index->entries;
+	unsigned long old_capacity = index->capacity;
+	unsigned long capacity = old_capacity ? 2 * old_capacity : INDEX_MIN_CAPACITY;
+
+	priqueue_index_entry_t *entries = calloc(capacity, sizeof(priqueue_index_entry_t));
+
+	if(entries == NULL)
+		return 0;
+
+	index->entries = entries;
+	index->capacity = capacity;
+
+	for(unsigned long i = 0; i < old_capacity; i++) {
+		if(old[i].handle == NULL)
+			continue;
+
+		unsigned long slot = index_hash(index, old[i].ptr);
+		while(entries[slot].handle != NULL)
+			slot = (slot + 1) & (capacity - 1);
+		entries[slot] = old[i];
+	}
+
+	free(old);
+
+	return 1;
+}
+
+
+/**
+  Records that handle holds ptr.
+
+  @return 0 if the table could not grow, 1 otherwise
+ */
+int priqueue_index_insert(priqueue_index_t *index, void *ptr, priqueue_handle_t handle)
+{
+	if(2 * (index->count + 1) > index->capacity && !index_grow(index))
+		return 0;
+
+	unsigned long slot = index_hash(index, ptr);
+	while(index->entries[slot].handle != NULL)
+		slot = (slot + 1) & (index->capacity - 1);
+
+	index->entries[slot].ptr = ptr;
+	index->entries[slot].handle = handle;
+	index->count++;
+
+	return 1;
+}
+
+
+/**
+  Returns a handle of some queued element equal (==) to ptr, or NULL.
+ */
+priqueue_handle_t priqueue_index_find(const priqueue_index_t *index, const void *ptr)
+{
+	if(index->count == 0)
+		return NULL;
+
+	unsigned long slot = index_hash(index, ptr);
+
+	while(index->entries[slot].handle != NULL) {
+		if(index->entries[slot].ptr == ptr)
+			return index->entries[slot].handle;
+
+		slot = (slot + 1) & (index->capacity - 1);
+	}
+
+	return NULL;
+}
+
+
+/**
+  Forgets the (ptr, handle) pair.
+ */
+void priqueue_index_delete(priqueue_index_t *index, const void *ptr, priqueue_handle_t handle)
+{
+	unsigned long mask = index->capacity - 1;
+	unsigned long slot = index_hash(index, ptr);
+
+	while(index->entries[slot].handle != handle)
+		slot = (slot + 1) & mask;
+
+	index->count--;
+
+	// shift back any later entry of this cluster that the hole now hides
+	unsigned long hole = slot;
+	unsigned long next = (slot + 1) & mask;
+
+	while(index->entries[next].handle != NULL) {
+		unsigned long home = index_hash(index, index->entries[next].ptr);
+
+		// move unless home lies cyclically in (hole, next]
+		if(((next - home) & mask) >= ((next - hole) & mask)) {
+			index->entries[hole] = index->entries[next];
+			hole = next;
+		}
+
+		next = (next + 1) & mask;
+	}
+
+	index->entries[hole].ptr = NULL;
+	index->entries[hole].handle = NULL;
+}
+
+
+/**
+  Moves every entry of src into index and leaves src empty. The larger
+  table is kept and the smaller one's entries inserted into it, so this is
+  O(min(n, m)) expected, plus a rehash if the kept table must grow.
+
+  @return 0, with both unchanged, if the table could not grow, 1 otherwise
+ */
+int priqueue_index_merge(priqueue_index_t *index, priqueue_index_t *src)
+{
+	priqueue_index_t *large = index, *small = src;
+
+	if(src->count > index->count) {
+		large = src;
+		small = index;
+	}
+
+	//grow up front, so no insert below can fail halfway
+	while(2 * (large->count + small->count) > large->capacity)
+		if(!index_grow(large))
+			return 0;
+
+	for(unsigned long i = 0; i < small->capacity; i++)
+		if(small->entries[i].handle != NULL)
+			priqueue_index_insert(large, small->entries[i].ptr, small->entries[i].handle);
+
+	priqueue_index_destroy(small);
+
+	if(large != index) {
+		*index = *large;
+		priqueue_index_init(large);
+	}
+
+	return 1;
+}
+
+
+void priqueue_index_destroy(priqueue_index_t *index)
+{
+	free(index->entries);
+	priqueue_index_init(index);
+}
+
+
+/**
+  The find operation of backends whose elements are all indexed.
+ */
+priqueue_handle_t priqueue_index_lookup(priqueue_t *q, void *ptr)
+{
+	return priqueue_index_find(&q->index, ptr);
+}
+
+
+/**
+  Allocates a node of the queue's pool size that will hold ptr, and
+  indexes it so priqueue_remove can find it. Backends call this for every
+  element they store; the node is the element's handle.
+
+  @return the node, or NULL if out of memory
+ */
+void *priqueue_node_new(priqueue_t *q, void *ptr)
+{
+	void *node = priqueue_pool_alloc(&q->pool);
+
+	if(node == NULL)
+		return NULL;
+
+	if(!priqueue_index_insert(&q->index, ptr, (priqueue_handle_t) node)) {
+		priqueue_pool_free(&q->pool, node);
+		return NULL;
+	}
+
+	PRIQUEUE_COUNT(q, allocs);
+
+	return node;
+}
+
+
+/**
+  Un-indexes a node from priqueue_node_new() and returns it to the pool.
+ */
+void priqueue_node_release(priqueue_t *q, void *ptr, void *node)
+{
+	priqueue_index_delete(&q->index, ptr, (priqueue_handle_t) node);
+	priqueue_pool_free(&q->pool, node);
+
+	PRIQUEUE_COUNT(q, frees);
+}
@@ -0,0 +1,94 @@
+/** @file priqueue_internal.h
+ */
+
+#ifndef PRIQUEUE_INTERNAL_H_
+#define PRIQUEUE_INTERNAL_H_
+
+#include "libpriqueue.h"
+
+/**
+  Operations every priqueue_t backend provides. The public priqueue_*
+  functions in libpriqueue.c forward to the table selected at init time.
+*/
+typedef struct _priqueue_ops
+{
+	void   (*init)     (priqueue_t *q);
+	int    (*offer)    (priqueue_t *q, void *ptr, priqueue_handle_t *handle);
+	int    (*offer_batch)(priqueue_t *q, void **ptrs, int n);	// optional
+	void * (*peek)     (priqueue_t *q);
+	void * (*poll)     (priqueue_t *q);
+	void * (*peek_max) (priqueue_t *q);	// optional
+	void * (*poll_max) (priqueue_t *q);	// optional
+	void * (*at)       (priqueue_t *q, int index);
+	void * (*remove_at)(priqueue_t *q, int index);
+	void * (*remove_handle)(priqueue_t *q, priqueue_handle_t handle);
+	priqueue_handle_t (*find)(priqueue_t *q, void *ptr);
+	int    (*remove)   (priqueue_t *q, void *ptr);	// optional
+	void   (*update)   (priqueue_t *q, priqueue_handle_t handle);
+	int    (*size)     (priqueue_t *q);
+	void * (*iter_begin)(priqueue_t *q, priqueue_iter_t *it);
+	void * (*iter_next) (priqueue_iter_t *it);
+	void * (*iter_remove)(priqueue_iter_t *it);
+	void   (*iter_end) (priqueue_iter_t *it);	// optional
+	int    (*clone)    (priqueue_t *dst, priqueue_t *src);	// optional
+	int    (*merge)    (priqueue_t *dst, priqueue_t *src);	// optional
+	int    (*split)    (priqueue_t *q, priqueue_t *out, int (*predicate)(const void *, void *), void *arg);	// optional
+	void   (*destroy)  (priqueue_t *q);
+} priqueue_ops_t;
+
+/**
+  Bumps one of q's priqueue_stats_t counters, or compiles to nothing when
+  PRIQUEUE_STATS is not defined.
+*/
+#ifdef PRIQUEUE_STATS
+#define PRIQUEUE_COUNT(q, counter) ((void) (q)->stats.counter++)
+#else
+#define PRIQUEUE_COUNT(q, counter) ((void) 0)
+#endif
+
+/**
+  Calls q's comparer, counting the comparison.
+*/
+#define PRIQUEUE_CMP(q, a, b) (PRIQUEUE_COUNT(q, comparisons), (q)->cmp((a), (b)))
+
+void   priqueue_pool_init   (priqueue_pool_t *pool, unsigned int object_size);
+void * priqueue_pool_alloc  (priqueue_pool_t *pool);
+void   priqueue_pool_free   (priqueue_pool_t *pool, void *object);
+void   priqueue_pool_destroy(priqueue_pool_t *pool);
+int    priqueue_pool_owns   (const priqueue_pool_t *pool, const void *object);
+void   priqueue_pool_merge  (priqueue_pool_t *pool, priqueue_pool_t *src);
+
+void              priqueue_index_init   (priqueue_index_t *index);
+int               priqueue_index_insert (priqueue_index_t *index, void *ptr, priqueue_handle_t handle);
+priqueue_handle_t priqueue_index_find   (const priqueue_index_t *index, const void *ptr);
+void              priqueue_index_delete (priqueue_index_t *index, const void *ptr, priqueue_handle_t handle);
+int               priqueue_index_merge  (priqueue_index_t *index, priqueue_index_t *src);
+void              priqueue_index_destroy(priqueue_index_t *index);
+priqueue_handle_t priqueue_index_lookup (priqueue_t *q, void *ptr);
+
+void * priqueue_node_new    (priqueue_t *q, void *ptr);
+void   priqueue_node_release(priqueue_t *q, void *ptr, void *node);
+
+extern const priqueue_ops_t priqueue_list_ops;
+extern const priqueue_ops_t priqueue_heap_ops;
+extern const priqueue_ops_t priqueue_tree_ops;
+extern const priqueue_ops_t priqueue_intrusive_ops;
+extern const priqueue_ops_t priqueue_concurrent_ops;
+extern const priqueue_ops_t priqueue_multiqueue_ops;
+extern const priqueue_ops_t priqueue_bucket_ops;
+extern const priqueue_ops_t priqueue_radix_ops;
+extern const priqueue_ops_t priqueue_keyed_ops;
+extern const priqueue_ops_t priqueue_minmax_ops;
+extern const priqueue_ops_t priqueue_dary_ops;
+extern const priqueue_ops_t priqueue_persistent_ops;
+extern const priqueue_ops_t priqueue_pairing_ops;
+
+void priqueue_tree_set_offset(priqueue_t *q, unsigned long offset);
+void priqueue_multiqueue_set_shards(priqueue_t *q, int shards);
+void priqueue_bucket_set_range(priqueue_t *q, int(*key)(const void *), int min_key, int max_key);
+void priqueue_radix_set_key(priqueue_t *q, unsigned long long (*key)(const void *));
+void priqueue_keyed_set_key(priqueue_t *q, unsigned long long (*key)(const void *));
+int  priqueue_keyed_offer(priqueue_t *q, void *ptr, unsigned long long key, priqueue_handle_t *handle);
+void priqueue_keyed_rekey(priqueue_t *q, priqueue_handle_t handle, unsigned long long key);
+
+#endif /* PRIQUEUE_INTERNAL_H_ */
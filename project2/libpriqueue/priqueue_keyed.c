@@ -0,0 +1,493 @@
+/** @file priqueue_keyed.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Key-cached binary heap backend.
+
+  Every element carries a 64-bit key, given by the caller or computed once
+  by the queue's key function when the element is offered or updated. The
+  heap is a structure of arrays: sifting reads only the keys and insertion
+  sequence numbers, which sit in their own contiguous arrays, so ordering
+  never follows an element pointer. Lower keys come first and equal keys
+  leave in FIFO order.
+
+  As in the heap backend, a slot from the queue's pool records each
+  element's array position and serves as its handle.
+
+  priqueue_at, priqueue_remove_at and cursors drain a sorted copy of the
+  heap, O(n + index log n).
+ */
+struct keyed_slot
+{
+	int pos;
+};
+
+typedef struct _keyed_t
+{
+	unsigned long long *keys;
+	unsigned long *seqs;
+	void **data;
+	struct keyed_slot **slots;
+	int size, capacity;
+	unsigned long next_seq;
+	unsigned long long (*key)(const void *);
+} keyed_t;
+
+// one element of a cursor's private copy
+struct keyed_entry
+{
+	unsigned long long key;
+	unsigned long seq;
+	void *data;
+	struct keyed_slot *slot;
+};
+
+
+static int keyed_less(priqueue_t *q, keyed_t *k, int a, int b)
+{
+	PRIQUEUE_COUNT(q, comparisons);
+
+	if(k->keys[a] != k->keys[b])
+		return k->keys[a] < k->keys[b];
+
+	return k->seqs[a] < k->seqs[b];
+}
+
+
+static void keyed_move(keyed_t *k, int to, int from)
+{
+	k->keys[to] = k->keys[from];
+	k->seqs[to] = k->seqs[from];
+	k->data[to] = k->data[from];
+	k->slots[to] = k->slots[from];
+	k->slots[to]->pos = to;
+}
+
+
+/**
+  Sifts the element held in the spare position k->capacity, which every
+  array keeps free, up from pos.
+ */
+static void keyed_sift_up(priqueue_t *q, keyed_t *k, int pos)
+{
+	int e = k->capacity;
+
+	while(pos > 0) {
+		int parent = (pos - 1) / 2;
+
+		if(!keyed_less(q, k, e, parent))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		keyed_move(k, pos, parent);
+		pos = parent;
+	}
+
+	keyed_move(k, pos, e);
+}
+
+
+static void keyed_sift_down(priqueue_t *q, keyed_t *k, int pos)
+{
+	int e = k->capacity;
+
+	while(1) {
+		int child = 2 * pos + 1;
+
+		if(child >= k->size)
+			break;
+
+		if(child + 1 < k->size && keyed_less(q, k, child + 1, child))
+			child++;
+
+		if(!keyed_less(q, k, child, e))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		keyed_move(k, pos, child);
+		pos = child;
+	}
+
+	keyed_move(k, pos, e);
+}
+
+
+/**
+  Takes the element at pos out into the spare position and puts it back
+  wherever the heap property holds.
+ */
+static void keyed_fix(priqueue_t *q, keyed_t *k, int pos)
+{
+	int e = k->capacity;
+
+	keyed_move(k, e, pos);
+
+	if(pos > 0 && keyed_less(q, k, e, (pos - 1) / 2))
+		keyed_sift_up(q, k, pos);
+	else
+		keyed_sift_down(q, k, pos);
+}
+
+
+static int keyed_grow(keyed_t *k)
+{
+	int capacity = k->capacity ? k->capacity * 2 : 16;
+
+	// one extra position past capacity is the sift scratch space
+	unsigned long long *keys = realloc(k->keys, (capacity + 1) * sizeof(unsigned long long));
+	if(keys == NULL)
+		return 0;
+	k->keys = keys;
+
+	unsigned long *seqs = realloc(k->seqs, (capacity + 1) * sizeof(unsigned long));
+	if(seqs == NULL)
+		return 0;
+	k->seqs = seqs;
+
+	void **data = realloc(k->data, (capacity + 1) * sizeof(void *));
+	if(data == NULL)
+		return 0;
+	k->data = data;
+
+	struct keyed_slot **slots = realloc(k->slots, (capacity + 1) * sizeof(struct keyed_slot *));
+	if(slots == NULL)
+		return 0;
+	k->slots = slots;
+
+	k->capacity = capacity;
+
+	return 1;
+}
+
+
+static void keyed_init(priqueue_t *q)
+{
+	keyed_t *k = malloc(sizeof(keyed_t));
+
+	k->capacity = 0;
+	k->size = 0;
+	k->next_seq = 0;
+	k->key = NULL;
+	k->keys = NULL;
+	k->seqs = NULL;
+	k->data = NULL;
+	k->slots = NULL;
+
+	//if this runs out of memory the first offer tries again, and fails if it can not
+	keyed_grow(k);
+
+	q->impl = k;
+	priqueue_pool_init(&q->pool, sizeof(struct keyed_slot));
+}
+
+
+/**
+  Offers ptr under an explicit key.
+ */
+int priqueue_keyed_offer(priqueue_t *q, void *ptr, unsigned long long key, priqueue_handle_t *handle)
+{
+	keyed_t *k = q->impl;
+
+	if(k->size == k->capacity && !keyed_grow(k))
+		return -1;
+
+	struct keyed_slot *slot = priqueue_node_new(q, ptr);
+	if(slot == NULL)
+		return -1;
+
+	int e = k->capacity;
+
+	k->keys[e] = key;
+	k->seqs[e] = k->next_seq++;
+	k->data[e] = ptr;
+	k->slots[e] = slot;
+
+	if(handle)
+		*handle = (priqueue_handle_t) slot;
+
+	keyed_sift_up(q, k, k->size++);
+
+	return slot->pos;
+}
+
+
+static int keyed_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	keyed_t *k = q->impl;
+
+	return priqueue_keyed_offer(q, ptr, k->key ? k->key(ptr) : 0, handle);
+}
+
+
+static void *keyed_peek(priqueue_t *q)
+{
+	keyed_t *k = q->impl;
+
+	return k->size ? k->data[0] : NULL;
+}
+
+
+static void *keyed_delete(priqueue_t *q, keyed_t *k, int pos)
+{
+	void *value = k->data[pos];
+
+	priqueue_node_release(q, value, k->slots[pos]);
+	k->size--;
+
+	if(pos != k->size) {
+		keyed_move(k, pos, k->size);
+		keyed_fix(q, k, pos);
+	}
+
+	return value;
+}
+
+
+static void *keyed_poll(priqueue_t *q)
+{
+	keyed_t *k = q->impl;
+
+	if(k->size == 0)
+		return NULL;
+
+	return keyed_delete(q, k, 0);
+}
+
+
+static int entry_less(const struct keyed_entry *a, const struct keyed_entry *b)
+{
+	if(a->key != b->key)
+		return a->key < b->key;
+
+	return a->seq < b->seq;
+}
+
+
+static void order_sift_down(struct keyed_entry *order, int size, int pos)
+{
+	struct keyed_entry e = order[pos];
+
+	while(1) {
+		int child = 2 * pos + 1;
+
+		if(child >= size)
+			break;
+
+		if(child + 1 < size && entry_less(&order[child + 1], &order[child]))
+			child++;
+
+		if(!entry_less(&order[child], &e))
+			break;
+
+		order[pos] = order[child];
+		pos = child;
+	}
+
+	order[pos] = e;
+}
+
+
+/**
+  Cursors drain a private copy of the heap, which removals from the real
+  heap leave alone.
+ */
+static void *keyed_iter_next(priqueue_iter_t *it)
+{
+	struct keyed_entry *order = it->order;
+
+	if(it->remaining == 0) {
+		it->current = NULL;
+		return NULL;
+	}
+
+	struct keyed_entry top = order[0];
+
+	order[0] = order[--it->remaining];
+	order_sift_down(order, it->remaining, 0);
+
+	it->current = (priqueue_handle_t) top.slot;
+
+	return top.data;
+}
+
+
+static void *keyed_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	keyed_t *k = q->impl;
+
+	if(k->size == 0)
+		return NULL;
+
+	struct keyed_entry *order = malloc(k->size * sizeof(struct keyed_entry));
+	if(order == NULL) {
+		it->error = 1;
+		return NULL;
+	}
+
+	// already a valid heap, in the same order
+	for(int i = 0; i < k->size; i++) {
+		order[i].key = k->keys[i];
+		order[i].seq = k->seqs[i];
+		order[i].data = k->data[i];
+		order[i].slot = k->slots[i];
+	}
+
+	it->order = order;
+	it->remaining = k->size;
+
+	return keyed_iter_next(it);
+}
+
+
+static void *keyed_iter_remove(priqueue_iter_t *it)
+{
+	struct keyed_slot *slot = (struct keyed_slot *) it->current;
+
+	return keyed_delete(it->q, it->q->impl, slot->pos);
+}
+
+
+/**
+  Heap position of the index'th element, or -1 if there is none or the
+  cursor's copy could not be allocated.
+ */
+static int keyed_select(priqueue_t *q, int index)
+{
+	keyed_t *k = q->impl;
+	priqueue_iter_t it;
+	int pos = -1;
+
+	if(index < 0 || index >= k->size)
+		return -1;
+
+	it.q = q;
+	it.order = NULL;
+	it.current = NULL;
+
+	//the queue is not empty, so no first element means the copy failed
+	if(keyed_iter_begin(q, &it) == NULL)
+		return -1;
+
+	for(int i = 0; i < index; i++)
+		keyed_iter_next(&it);
+
+	pos = ((struct keyed_slot *) it.current)->pos;
+	free(it.order);
+
+	return pos;
+}
+
+
+static void *keyed_at(priqueue_t *q, int index)
+{
+	keyed_t *k = q->impl;
+	int pos = keyed_select(q, index);
+
+	return pos == -1 ? NULL : k->data[pos];
+}
+
+
+static void *keyed_remove_at(priqueue_t *q, int index)
+{
+	int pos = keyed_select(q, index);
+
+	return pos == -1 ? NULL : keyed_delete(q, q->impl, pos);
+}
+
+
+static void *keyed_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct keyed_slot *slot = (struct keyed_slot *) handle;
+
+	return keyed_delete(q, q->impl, slot->pos);
+}
+
+
+/**
+  Gives the element behind handle a new key and moves it accordingly.
+ */
+void priqueue_keyed_rekey(priqueue_t *q, priqueue_handle_t handle, unsigned long long key)
+{
+	keyed_t *k = q->impl;
+	struct keyed_slot *slot = (struct keyed_slot *) handle;
+
+	k->keys[slot->pos] = key;
+	keyed_fix(q, k, slot->pos);
+}
+
+
+static void keyed_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	keyed_t *k = q->impl;
+	struct keyed_slot *slot = (struct keyed_slot *) handle;
+
+	if(k->key)
+		priqueue_keyed_rekey(q, handle, k->key(k->data[slot->pos]));
+}
+
+
+static int keyed_size(priqueue_t *q)
+{
+	keyed_t *k = q->impl;
+
+	return k->size;
+}
+
+
+static void keyed_destroy(priqueue_t *q)
+{
+	keyed_t *k = q->impl;
+
+	free(k->keys);
+	free(k->seqs);
+	free(k->data);
+	free(k->slots);
+	free(k);
+
+	q->impl = NULL;
+}
+
+
+/**
+  Sets the function that computes keys for priqueue_offer and
+  priqueue_update; NULL keys those elements 0.
+ */
+void priqueue_keyed_set_key(priqueue_t *q, unsigned long long (*key)(const void *))
+{
+	keyed_t *k = q->impl;
+
+	k->key = key;
+}
+
+
+const priqueue_ops_t priqueue_keyed_ops =
+{
+	keyed_init,
+	keyed_offer,
+	NULL,
+	keyed_peek,
+	keyed_poll,
+	NULL,
+	NULL,
+	keyed_at,
+	keyed_remove_at,
+	keyed_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	keyed_update,
+	keyed_size,
+	keyed_iter_begin,
+	keyed_iter_next,
+	keyed_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	keyed_destroy
+};
@@ -0,0 +1,372 @@
+/** @file priqueue_list.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Sorted singly linked list backend. Elements that compare equal keep
+  their arrival (FIFO) order.
+ */
+static void list_init(priqueue_t *q)
+{
+	q->head = NULL;
+	priqueue_pool_init(&q->pool, sizeof(struct node));
+}
+
+
+/**
+  Links insert into its sorted position and returns that position.
+ */
+static int list_link(priqueue_t *q, struct node *insert)
+{
+	int index = 0;
+	struct node *temp;
+	struct node *previous;
+
+	insert->next = NULL;
+
+	//check for other nodes
+	if (q->head == NULL) {
+		q->head = insert;
+	}
+	//compare the new node to the first node
+	else if(PRIQUEUE_CMP(q, insert->data, q->head->data) < 0) {
+		insert->next = q->head;
+		q->head = insert;
+	}
+	else {
+		previous = q->head;
+		temp = q->head->next;
+		index = 1;
+
+		//determine where the new node needs to be inserted, after any equal ones
+		while(temp != NULL && PRIQUEUE_CMP(q, insert->data, temp->data) >= 0)
+		{
+			PRIQUEUE_COUNT(q, hops);
+			previous = temp;
+			temp = temp->next;
+			index++;
+		}
+
+		//insert the node at the position
+		if(temp == NULL)
+		{
+			previous->next = insert;
+		}
+		else
+		{
+			insert->next = temp;
+			previous->next = insert;
+		}
+	}
+
+	return index;
+}
+
+
+static int list_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	struct node *insert = priqueue_node_new(q, ptr);
+
+	if(insert == NULL)
+		return -1;
+
+	insert->data = ptr;
+
+	if(handle)
+		*handle = (priqueue_handle_t) insert;
+
+	return list_link(q, insert);
+}
+
+
+/**
+  Merges two sorted lists. On ties a's node comes first, so when a holds
+  the older elements FIFO order is kept.
+ */
+static struct node *list_merge(priqueue_t *q, struct node *a, struct node *b)
+{
+	struct node merged;
+	struct node *tail = &merged;
+
+	while(a != NULL && b != NULL) {
+		if(PRIQUEUE_CMP(q, b->data, a->data) < 0) {
+			tail->next = b;
+			b = b->next;
+		}
+		else {
+			tail->next = a;
+			a = a->next;
+		}
+		tail = tail->next;
+	}
+
+	tail->next = (a != NULL) ? a : b;
+
+	return merged.next;
+}
+
+
+/**
+  Stable merge sort of a list of n nodes.
+ */
+static struct node *list_sort(priqueue_t *q, struct node *n, int count)
+{
+	if(count < 2)
+		return n;
+
+	struct node *middle = n;
+	for(int i = 1; i < count / 2; i++)
+		middle = middle->next;
+
+	struct node *second = middle->next;
+	middle->next = NULL;
+
+	return list_merge(q, list_sort(q, n, count / 2), list_sort(q, second, count - count / 2));
+}
+
+
+/**
+  Sorts the batch on its own, O(n log n), then merges it into the queue in
+  one pass instead of walking the list once per element.
+ */
+static int list_offer_batch(priqueue_t *q, void **ptrs, int n)
+{
+	struct node batch;
+	struct node *tail = &batch;
+	int count;
+
+	for(count = 0; count < n; count++) {
+		struct node *insert = priqueue_node_new(q, ptrs[count]);
+
+		if(insert == NULL)
+			break;
+
+		insert->data = ptrs[count];
+		tail->next = insert;
+		tail = insert;
+	}
+	tail->next = NULL;
+
+	q->head = list_merge(q, q->head, list_sort(q, batch.next, count));
+
+	return count;
+}
+
+
+static void *list_peek(priqueue_t *q)
+{
+	if(q->head == NULL)
+		return NULL;
+
+	return q->head->data;
+}
+
+
+static void *list_poll(priqueue_t *q)
+{
+	if(q->head == NULL)
+		return NULL;
+
+	struct node *head = q->head;
+	void* value = head->data;
+	q->head = head->next;
+
+	priqueue_node_release(q, value, head);
+
+	return value;
+}
+
+
+static void *list_at(priqueue_t *q, int index)
+{
+	int i = 0;
+	struct node *n = q->head;
+
+	while(i != index && n != NULL) {
+		PRIQUEUE_COUNT(q, hops);
+		n = n->next;
+
+		i++;
+	}
+
+	if(n == NULL)
+		return NULL;
+
+	return n->data;
+}
+
+
+static void *list_remove_at(priqueue_t *q, int index)
+{
+	int i = 0;
+	struct node* prev = NULL;
+	struct node* n = q->head;
+
+	while(i != index && n != NULL) {
+		PRIQUEUE_COUNT(q, hops);
+		prev = n;
+		n = n->next;
+
+		i++;
+	}
+
+	if(n == NULL)
+		return NULL;
+
+	if(n == q->head) {
+		q->head = q->head->next;
+	}
+	else {
+		prev->next = n->next;
+	}
+
+	void *value = n->data;
+	priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+/**
+  Unlinks n; a singly linked list has to find the predecessor first.
+ */
+static void list_unlink(priqueue_t *q, struct node *n)
+{
+	if(q->head == n) {
+		q->head = n->next;
+	}
+	else {
+		struct node *prev = q->head;
+		while(prev->next != n) {
+			PRIQUEUE_COUNT(q, hops);
+			prev = prev->next;
+		}
+		prev->next = n->next;
+	}
+}
+
+
+static void *list_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct node *n = (struct node *) handle;
+	void *value = n->data;
+
+	list_unlink(q, n);
+	priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+static void list_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct node *n = (struct node *) handle;
+
+	//unlink the node and walk it back in from the head
+	list_unlink(q, n);
+	list_link(q, n);
+}
+
+
+static int list_size(priqueue_t *q)
+{
+	int count = 0;
+	struct node* n;
+	n = q->head;
+
+	while(n != NULL) {
+		n = n->next;
+		count++;
+	}
+
+	return count;
+}
+
+
+static void *list_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	struct node *n = q->head;
+
+	it->current = (priqueue_handle_t) n;
+
+	return n ? n->data : NULL;
+}
+
+
+static void *list_iter_next(priqueue_iter_t *it)
+{
+	struct node *n = (struct node *) it->current;
+	struct node *prev = it->prev;
+
+	if(n != NULL) {
+		it->prev = n;
+		n = n->next;
+	}
+	else {
+		//current was removed; its successor now follows prev
+		n = prev ? prev->next : it->q->head;
+	}
+
+	it->current = (priqueue_handle_t) n;
+
+	return n ? n->data : NULL;
+}
+
+
+/**
+  The cursor remembers the previous node, so unlinking is O(1).
+ */
+static void *list_iter_remove(priqueue_iter_t *it)
+{
+	struct node *n = (struct node *) it->current;
+	struct node *prev = it->prev;
+	void *value = n->data;
+
+	if(prev == NULL)
+		it->q->head = n->next;
+	else
+		prev->next = n->next;
+
+	priqueue_node_release(it->q, value, n);
+
+	return value;
+}
+
+
+static void list_destroy(priqueue_t *q)
+{
+	//the nodes go back with the pool's slabs
+	q->head = NULL;
+}
+
+
+const priqueue_ops_t priqueue_list_ops =
+{
+	list_init,
+	list_offer,
+	list_offer_batch,
+	list_peek,
+	list_poll,
+	NULL,
+	NULL,
+	list_at,
+	list_remove_at,
+	list_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	list_update,
+	list_size,
+	list_iter_begin,
+	list_iter_next,
+	list_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	list_destroy
+};
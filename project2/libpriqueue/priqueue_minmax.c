@@ -0,0 +1,483 @@
+/** @file priqueue_minmax.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Array-backed min-max heap backend, for queues that are taken from at
+  both ends.
+
+  After Atkinson, Sack, Santoro and Strothotte, "Min-Max Heaps and
+  Generalized Priority Queues" (CACM 1986). Levels alternate: an entry on
+  an even level (the root's) is the smallest in its subtree, one on an odd
+  level the greatest. The front is the root and the back is the greater of
+  its two children, so both can be peeked in O(1) and polled in O(log n).
+
+  As in the heap backend, entries carry an insertion sequence number that
+  puts equal elements in FIFO order, and a slot from the queue's pool that
+  records the entry's position and serves as its handle.
+
+  priqueue_at, priqueue_remove_at and cursors drain a private binary heap
+  built from a copy of the array, O(n + index log n).
+ */
+struct minmax_slot
+{
+	int pos;
+};
+
+struct minmax_entry
+{
+	void *data;
+	unsigned long seq;
+	struct minmax_slot *slot;
+};
+
+typedef struct _minmax_t
+{
+	struct minmax_entry *entries;
+	int size, capacity;
+	unsigned long next_seq;
+} minmax_t;
+
+
+static int entry_less(priqueue_t *q, const struct minmax_entry *a, const struct minmax_entry *b)
+{
+	int diff = PRIQUEUE_CMP(q, a->data, b->data);
+
+	if(diff == 0)
+		return a->seq < b->seq;
+
+	return diff < 0;
+}
+
+
+/**
+  Whether the entry at a belongs closer to its level's end of the queue
+  than the one at b: smaller on a min level, greater on a max level.
+ */
+static int minmax_before(priqueue_t *q, minmax_t *m, int a, int b, int max_level)
+{
+	if(max_level)
+		return entry_less(q, &m->entries[b], &m->entries[a]);
+
+	return entry_less(q, &m->entries[a], &m->entries[b]);
+}
+
+
+static int minmax_is_max_level(int pos)
+{
+	return (31 - __builtin_clz(pos + 1)) & 1;
+}
+
+
+static void minmax_swap(minmax_t *m, int a, int b)
+{
+	struct minmax_entry e = m->entries[a];
+
+	m->entries[a] = m->entries[b];
+	m->entries[b] = e;
+
+	m->entries[a].slot->pos = a;
+	m->entries[b].slot->pos = b;
+}
+
+
+/**
+  Moves the entry at pos up through the grandparents on its own kind of
+  level.
+ */
+static void minmax_bubble_up(priqueue_t *q, minmax_t *m, int pos, int max_level)
+{
+	while(pos > 2) {
+		int grandparent = ((pos - 1) / 2 - 1) / 2;
+
+		if(!minmax_before(q, m, pos, grandparent, max_level))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		minmax_swap(m, pos, grandparent);
+		pos = grandparent;
+	}
+}
+
+
+static void minmax_sift_up(priqueue_t *q, minmax_t *m, int pos)
+{
+	if(pos == 0)
+		return;
+
+	int max_level = minmax_is_max_level(pos);
+	int parent = (pos - 1) / 2;
+
+	//an entry that belongs on the other kind of level crosses over to its parent
+	if(minmax_before(q, m, parent, pos, max_level)) {
+		minmax_swap(m, pos, parent);
+		minmax_bubble_up(q, m, parent, !max_level);
+	}
+	else {
+		minmax_bubble_up(q, m, pos, max_level);
+	}
+}
+
+
+static void minmax_sift_down(priqueue_t *q, minmax_t *m, int pos)
+{
+	int max_level = minmax_is_max_level(pos);
+
+	while(2 * pos + 1 < m->size) {
+		int best = 2 * pos + 1;
+
+		//the extreme among the children and grandchildren
+		int candidates[5] = { 2 * pos + 2, 4 * pos + 3, 4 * pos + 4, 4 * pos + 5, 4 * pos + 6 };
+		for(int i = 0; i < 5 && candidates[i] < m->size; i++)
+			if(minmax_before(q, m, candidates[i], best, max_level))
+				best = candidates[i];
+
+		if(!minmax_before(q, m, best, pos, max_level))
+			break;
+
+		PRIQUEUE_COUNT(q, hops);
+		minmax_swap(m, pos, best);
+
+		if(best <= 2 * pos + 2)
+			break;
+
+		//a grandchild moved down past its parent, which sits on the other kind of level
+		int parent = (best - 1) / 2;
+		if(minmax_before(q, m, parent, best, max_level))
+			minmax_swap(m, best, parent);
+
+		pos = best;
+	}
+}
+
+
+/**
+  Moves the entry at pos, whose key may have changed either way, to where
+  it belongs. Sifting down first leaves it on a level whose subtree it
+  fits, so only its ancestors are left to settle.
+ */
+static void minmax_fix(priqueue_t *q, minmax_t *m, int pos)
+{
+	struct minmax_slot *slot = m->entries[pos].slot;
+
+	minmax_sift_down(q, m, pos);
+	minmax_sift_up(q, m, slot->pos);
+}
+
+
+static void *minmax_delete(priqueue_t *q, minmax_t *m, int pos)
+{
+	void *value = m->entries[pos].data;
+
+	priqueue_node_release(q, value, m->entries[pos].slot);
+	m->size--;
+
+	if(pos != m->size) {
+		m->entries[pos] = m->entries[m->size];
+		m->entries[pos].slot->pos = pos;
+		minmax_fix(q, m, pos);
+	}
+
+	return value;
+}
+
+
+/**
+  Position of the greatest entry, or -1.
+ */
+static int minmax_back(priqueue_t *q, minmax_t *m)
+{
+	if(m->size <= 2)
+		return m->size - 1;
+
+	return entry_less(q, &m->entries[1], &m->entries[2]) ? 2 : 1;
+}
+
+
+static void minmax_init(priqueue_t *q)
+{
+	minmax_t *m = malloc(sizeof(minmax_t));
+
+	m->size = 0;
+	m->next_seq = 0;
+	m->entries = malloc(16 * sizeof(struct minmax_entry));
+	//without an array the first offer tries again, and fails if it can not
+	m->capacity = m->entries ? 16 : 0;
+
+	q->impl = m;
+	priqueue_pool_init(&q->pool, sizeof(struct minmax_slot));
+}
+
+
+static int minmax_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	minmax_t *m = q->impl;
+
+	if(m->size == m->capacity) {
+		int capacity = m->capacity ? 2 * m->capacity : 16;
+		struct minmax_entry *grown = realloc(m->entries, capacity * sizeof(struct minmax_entry));
+
+		if(grown == NULL)
+			return -1;
+
+		m->entries = grown;
+		m->capacity = capacity;
+	}
+
+	struct minmax_slot *slot = priqueue_node_new(q, ptr);
+
+	if(slot == NULL)
+		return -1;
+
+	if(handle)
+		*handle = (priqueue_handle_t) slot;
+
+	int pos = m->size++;
+	m->entries[pos].data = ptr;
+	m->entries[pos].seq = m->next_seq++;
+	m->entries[pos].slot = slot;
+	slot->pos = pos;
+
+	minmax_sift_up(q, m, pos);
+
+	return slot->pos;
+}
+
+
+static void *minmax_peek(priqueue_t *q)
+{
+	minmax_t *m = q->impl;
+
+	return m->size ? m->entries[0].data : NULL;
+}
+
+
+static void *minmax_poll(priqueue_t *q)
+{
+	minmax_t *m = q->impl;
+
+	if(m->size == 0)
+		return NULL;
+
+	return minmax_delete(q, m, 0);
+}
+
+
+static void *minmax_peek_max(priqueue_t *q)
+{
+	minmax_t *m = q->impl;
+	int pos = minmax_back(q, m);
+
+	return pos == -1 ? NULL : m->entries[pos].data;
+}
+
+
+static void *minmax_poll_max(priqueue_t *q)
+{
+	minmax_t *m = q->impl;
+	int pos = minmax_back(q, m);
+
+	return pos == -1 ? NULL : minmax_delete(q, m, pos);
+}
+
+
+static void order_sift_down(priqueue_t *q, struct minmax_entry *order, int size, int pos)
+{
+	struct minmax_entry e = order[pos];
+
+	while(1) {
+		int child = 2 * pos + 1;
+
+		if(child >= size)
+			break;
+
+		if(child + 1 < size && entry_less(q, &order[child + 1], &order[child]))
+			child++;
+
+		if(!entry_less(q, &order[child], &e))
+			break;
+
+		order[pos] = order[child];
+		pos = child;
+	}
+
+	order[pos] = e;
+}
+
+
+/**
+  Cursors drain a private binary heap built from a copy of the array,
+  which removals from the real queue leave alone.
+ */
+static void *minmax_iter_next(priqueue_iter_t *it)
+{
+	struct minmax_entry *order = it->order;
+
+	if(it->remaining == 0) {
+		it->current = NULL;
+		return NULL;
+	}
+
+	struct minmax_entry top = order[0];
+
+	order[0] = order[--it->remaining];
+	order_sift_down(it->q, order, it->remaining, 0);
+
+	it->current = (priqueue_handle_t) top.slot;
+
+	return top.data;
+}
+
+
+static void *minmax_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	minmax_t *m = q->impl;
+
+	if(m->size == 0)
+		return NULL;
+
+	struct minmax_entry *order = malloc(m->size * sizeof(struct minmax_entry));
+	if(order == NULL) {
+		it->error = 1;
+		return NULL;
+	}
+
+	for(int i = 0; i < m->size; i++)
+		order[i] = m->entries[i];
+
+	for(int pos = m->size / 2 - 1; pos >= 0; pos--)
+		order_sift_down(q, order, m->size, pos);
+
+	it->order = order;
+	it->remaining = m->size;
+
+	return minmax_iter_next(it);
+}
+
+
+static void *minmax_iter_remove(priqueue_iter_t *it)
+{
+	struct minmax_slot *slot = (struct minmax_slot *) it->current;
+
+	return minmax_delete(it->q, it->q->impl, slot->pos);
+}
+
+
+/**
+  Array position of the index'th element, or -1.
+ */
+static int minmax_select(priqueue_t *q, int index)
+{
+	minmax_t *m = q->impl;
+	priqueue_iter_t it;
+	int pos;
+
+	if(index < 0 || index >= m->size)
+		return -1;
+
+	if(index == 0)
+		return 0;
+
+	if(index == m->size - 1)
+		return minmax_back(q, m);
+
+	it.q = q;
+	it.order = NULL;
+	it.current = NULL;
+
+	//the queue is not empty, so no first element means the copy failed
+	if(minmax_iter_begin(q, &it) == NULL)
+		return -1;
+
+	for(int i = 0; i < index; i++)
+		minmax_iter_next(&it);
+
+	pos = ((struct minmax_slot *) it.current)->pos;
+	free(it.order);
+
+	return pos;
+}
+
+
+static void *minmax_at(priqueue_t *q, int index)
+{
+	minmax_t *m = q->impl;
+	int pos = minmax_select(q, index);
+
+	return pos == -1 ? NULL : m->entries[pos].data;
+}
+
+
+static void *minmax_remove_at(priqueue_t *q, int index)
+{
+	int pos = minmax_select(q, index);
+
+	return pos == -1 ? NULL : minmax_delete(q, q->impl, pos);
+}
+
+
+static void *minmax_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct minmax_slot *slot = (struct minmax_slot *) handle;
+
+	return minmax_delete(q, q->impl, slot->pos);
+}
+
+
+static void minmax_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	struct minmax_slot *slot = (struct minmax_slot *) handle;
+
+	minmax_fix(q, q->impl, slot->pos);
+}
+
+
+static int minmax_size(priqueue_t *q)
+{
+	minmax_t *m = q->impl;
+
+	return m->size;
+}
+
+
+static void minmax_destroy(priqueue_t *q)
+{
+	minmax_t *m = q->impl;
+
+	free(m->entries);
+	free(m);
+
+	q->impl = NULL;
+}
+
+
+const priqueue_ops_t priqueue_minmax_ops =
+{
+	minmax_init,
+	minmax_offer,
+	NULL,
+	minmax_peek,
+	minmax_poll,
+	minmax_peek_max,
+	minmax_poll_max,
+	minmax_at,
+	minmax_remove_at,
+	minmax_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	minmax_update,
+	minmax_size,
+	minmax_iter_begin,
+	minmax_iter_next,
+	minmax_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	minmax_destroy
+};
@@ -0,0 +1,550 @@
+/** @file priqueue_multiqueue.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Relaxed MultiQueue, for queues shared by many threads that can live with
+  approximate priority order.
+
+  After Rihani, Sanders and Dementiev, "MultiQueues: Simple Relaxed
+  Concurrent Priority Queues" (SPAA 2015). The queue is split into shards,
+  each a heap priqueue_t behind its own mutex. An offer goes to a random
+  shard; a poll looks at the cached heads of two random shards and takes
+  the better one. Threads lock different shards most of the time, so there
+  is no single serialization point, at the price of sometimes returning an
+  element that is not the global minimum. With c shards per thread the
+  expected rank error is O(c * threads).
+
+  Locks are only tried, never waited for: a busy shard is swapped for
+  another random one. Ties keep FIFO order within a shard only.
+
+  The heaps hold an entry per element that records its shard, and the
+  entry is the element's handle, so priqueue_remove_handle and
+  priqueue_update lock only the shard that holds the element.
+
+  priqueue_at, priqueue_remove_at and cursors lock every shard and merge
+  them, so they are exact but serialize the whole queue.
+ */
+typedef struct _mq_shard_t
+{
+	pthread_mutex_t lock;
+	priqueue_t heap;	// of mq_entry_t
+	priqueue_pool_t entries;
+	_Atomic(void *) top;	// element at the head of heap, read without the lock
+} __attribute__((aligned(64))) mq_shard_t;
+
+typedef struct _mq_entry_t
+{
+	void *ptr;
+	int(*cmp)(const void *, const void *);
+	priqueue_handle_t handle;	// in the shard's heap
+	int shard;
+} mq_entry_t;
+
+typedef struct _mq_t
+{
+	mq_shard_t *shards;
+	int num_shards;
+	atomic_int count;
+} mq_t;
+
+static __thread unsigned int mq_rng;
+
+
+static int mq_random(mq_t *m)
+{
+	if(mq_rng == 0)
+		mq_rng = (unsigned int)(uintptr_t) &mq_rng | 1;
+
+	mq_rng ^= mq_rng << 13;
+	mq_rng ^= mq_rng >> 17;
+	mq_rng ^= mq_rng << 5;
+
+	return mq_rng % m->num_shards;
+}
+
+
+static int entry_cmp(const void *a, const void *b)
+{
+	const mq_entry_t *x = a, *y = b;
+
+	return x->cmp(x->ptr, y->ptr);
+}
+
+
+/**
+  Refreshes the cached head; called with the shard locked.
+ */
+static void shard_publish(mq_shard_t *s)
+{
+	mq_entry_t *e = priqueue_peek(&s->heap);
+
+	atomic_store(&s->top, e == NULL ? NULL : e->ptr);
+}
+
+
+/**
+  Takes entry e out of its shard's bookkeeping and returns its element;
+  called with the shard locked, after e has left the heap.
+ */
+static void *shard_release(mq_shard_t *s, mq_entry_t *e)
+{
+	void *ptr = e->ptr;
+
+	priqueue_pool_free(&s->entries, e);
+
+	return ptr;
+}
+
+
+static void lock_all(mq_t *m)
+{
+	for(int i = 0; i < m->num_shards; i++)
+		pthread_mutex_lock(&m->shards[i].lock);
+}
+
+
+static void unlock_all(mq_t *m)
+{
+	for(int i = 0; i < m->num_shards; i++)
+		pthread_mutex_unlock(&m->shards[i].lock);
+}
+
+
+static void mq_init(priqueue_t *q)
+{
+	mq_t *m = malloc(sizeof(mq_t));
+
+	// the shards are added by priqueue_concurrent_init_flags()
+	m->shards = NULL;
+	m->num_shards = 0;
+	atomic_init(&m->count, 0);
+
+	q->impl = m;
+}
+
+
+static int mq_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	mq_t *m = q->impl;
+	mq_shard_t *s;
+
+	//the shards could not be allocated
+	if(m->num_shards == 0)
+		return -1;
+
+	atomic_fetch_add(&m->count, 1);
+
+	do {
+		s = &m->shards[mq_random(m)];
+	} while(pthread_mutex_trylock(&s->lock) != 0);
+
+	int index = -1;
+	mq_entry_t *e = priqueue_pool_alloc(&s->entries);
+
+	if(e != NULL) {
+		e->ptr = ptr;
+		e->cmp = q->cmp;
+		e->shard = s - m->shards;
+
+		index = priqueue_offer_handle(&s->heap, e, &e->handle);
+
+		if(index < 0)
+			shard_release(s, e);
+		else if(handle)
+			*handle = (priqueue_handle_t) e;
+	}
+
+	shard_publish(s);
+	pthread_mutex_unlock(&s->lock);
+
+	if(index < 0)
+		atomic_fetch_sub(&m->count, 1);
+
+	return index;
+}
+
+
+/**
+  The best of the shard heads, which is the true minimum only when no
+  other thread is changing the queue.
+ */
+static void *mq_peek(priqueue_t *q)
+{
+	mq_t *m = q->impl;
+	void *best = NULL;
+
+	for(int i = 0; i < m->num_shards; i++) {
+		void *top = atomic_load(&m->shards[i].top);
+
+		if(top != NULL && (best == NULL || PRIQUEUE_CMP(q, top, best) < 0))
+			best = top;
+	}
+
+	return best;
+}
+
+
+static void *mq_poll(priqueue_t *q)
+{
+	mq_t *m = q->impl;
+	int misses = 0;
+
+	while(atomic_load(&m->count) > 0) {
+		mq_shard_t *s;
+
+		if(misses < 2 * m->num_shards) {
+			//two random choices, the better head wins
+			mq_shard_t *a = &m->shards[mq_random(m)];
+			mq_shard_t *b = &m->shards[mq_random(m)];
+			void *top_a = atomic_load(&a->top);
+			void *top_b = atomic_load(&b->top);
+
+			if(top_a == NULL && top_b == NULL) {
+				misses++;
+				continue;
+			}
+
+			s = (top_b == NULL || (top_a != NULL && PRIQUEUE_CMP(q, top_a, top_b) <= 0)) ? a : b;
+
+			if(pthread_mutex_trylock(&s->lock) != 0)
+				continue;
+		}
+		else {
+			//few elements left: sweep the shards rather than keep guessing
+			s = &m->shards[misses++ % m->num_shards];
+			pthread_mutex_lock(&s->lock);
+		}
+
+		mq_entry_t *e = priqueue_poll(&s->heap);
+		void *value = e == NULL ? NULL : shard_release(s, e);
+		shard_publish(s);
+		pthread_mutex_unlock(&s->lock);
+
+		if(value != NULL) {
+			atomic_fetch_sub(&m->count, 1);
+			return value;
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+  Cursors lock every shard until priqueue_iter_end() and merge the
+  shards' own cursors, taking the best head each step.
+ */
+typedef struct _mq_cursor_t
+{
+	priqueue_iter_t it;
+	mq_entry_t *entry;
+} mq_cursor_t;
+
+
+static void *mq_iter_pick(priqueue_iter_t *it)
+{
+	mq_t *m = it->q->impl;
+	mq_cursor_t *cursors = it->order;
+	int best = -1;
+
+	for(int i = 0; i < m->num_shards; i++)
+		if(cursors[i].entry != NULL && (best == -1 || PRIQUEUE_CMP(it->q, cursors[i].entry->ptr, cursors[best].entry->ptr) < 0))
+			best = i;
+
+	it->remaining = best;
+	it->current = best == -1 ? NULL : (priqueue_handle_t) cursors[best].entry;
+
+	return best == -1 ? NULL : cursors[best].entry->ptr;
+}
+
+
+static void *mq_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	mq_t *m = q->impl;
+	mq_cursor_t *cursors = malloc(m->num_shards * sizeof(mq_cursor_t));
+
+	if(cursors == NULL) {
+		it->error = m->num_shards > 0;
+		it->remaining = -1;
+		return NULL;
+	}
+
+	lock_all(m);
+	it->order = cursors;
+
+	for(int i = 0; i < m->num_shards; i++) {
+		cursors[i].entry = priqueue_iter_begin(&m->shards[i].heap, &cursors[i].it);
+
+		if(cursors[i].it.error)
+			it->error = 1;
+	}
+
+	//a shard whose heap could not be copied would be skipped, so walk nothing
+	if(it->error) {
+		it->remaining = -1;
+		return NULL;
+	}
+
+	return mq_iter_pick(it);
+}
+
+
+static void *mq_iter_next(priqueue_iter_t *it)
+{
+	mq_cursor_t *cursors = it->order;
+
+	if(it->remaining == -1)
+		return NULL;
+
+	mq_cursor_t *c = &cursors[it->remaining];
+	c->entry = priqueue_iter_next(&c->it);
+
+	return mq_iter_pick(it);
+}
+
+
+static void *mq_iter_remove(priqueue_iter_t *it)
+{
+	mq_t *m = it->q->impl;
+	mq_cursor_t *cursors = it->order;
+	mq_shard_t *s = &m->shards[it->remaining];
+
+	void *value = shard_release(s, priqueue_iter_remove_current(&cursors[it->remaining].it));
+	shard_publish(s);
+	atomic_fetch_sub(&m->count, 1);
+
+	return value;
+}
+
+
+static void mq_iter_end(priqueue_iter_t *it)
+{
+	mq_t *m = it->q->impl;
+	mq_cursor_t *cursors = it->order;
+
+	//never opened, for lack of memory
+	if(cursors == NULL)
+		return;
+
+	for(int i = 0; i < m->num_shards; i++)
+		priqueue_iter_end(&cursors[i].it);
+
+	unlock_all(m);
+}
+
+
+static void *mq_at(priqueue_t *q, int index)
+{
+	priqueue_iter_t it;
+	void *value = index < 0 ? NULL : priqueue_iter_begin(q, &it);
+
+	for(int i = 0; value != NULL && i < index; i++)
+		value = priqueue_iter_next(&it);
+
+	if(index >= 0)
+		priqueue_iter_end(&it);
+
+	return value;
+}
+
+
+static void *mq_remove_at(priqueue_t *q, int index)
+{
+	priqueue_iter_t it;
+	void *value = index < 0 ? NULL : priqueue_iter_begin(q, &it);
+
+	for(int i = 0; value != NULL && i < index; i++)
+		value = priqueue_iter_next(&it);
+
+	if(value != NULL)
+		priqueue_iter_remove_current(&it);
+
+	if(index >= 0)
+		priqueue_iter_end(&it);
+
+	return value;
+}
+
+
+static void *mq_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	mq_t *m = q->impl;
+	mq_entry_t *e = (mq_entry_t *) handle;
+	mq_shard_t *s = &m->shards[e->shard];
+
+	pthread_mutex_lock(&s->lock);
+
+	priqueue_remove_handle(&s->heap, e->handle);
+	void *value = shard_release(s, e);
+	shard_publish(s);
+	pthread_mutex_unlock(&s->lock);
+
+	atomic_fetch_sub(&m->count, 1);
+
+	return value;
+}
+
+
+static priqueue_handle_t mq_find(priqueue_t *q, void *ptr)
+{
+	mq_t *m = q->impl;
+	priqueue_handle_t handle = NULL;
+
+	for(int i = 0; i < m->num_shards && handle == NULL; i++) {
+		mq_shard_t *s = &m->shards[i];
+
+		priqueue_iter_t it;
+
+		pthread_mutex_lock(&s->lock);
+		for(mq_entry_t *e = priqueue_iter_begin(&s->heap, &it); e != NULL; e = priqueue_iter_next(&it)) {
+			if(e->ptr == ptr) {
+				handle = (priqueue_handle_t) e;
+				break;
+			}
+		}
+		priqueue_iter_end(&it);
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	return handle;
+}
+
+
+static int mq_remove(priqueue_t *q, void *ptr)
+{
+	mq_t *m = q->impl;
+	int removed = 0;
+
+	for(int i = 0; i < m->num_shards; i++) {
+		mq_shard_t *s = &m->shards[i];
+
+		priqueue_iter_t it;
+		int count = 0;
+
+		pthread_mutex_lock(&s->lock);
+		for(mq_entry_t *e = priqueue_iter_begin(&s->heap, &it); e != NULL; e = priqueue_iter_next(&it)) {
+			if(e->ptr == ptr) {
+				shard_release(s, priqueue_iter_remove_current(&it));
+				count++;
+			}
+		}
+		priqueue_iter_end(&it);
+		shard_publish(s);
+		pthread_mutex_unlock(&s->lock);
+
+		atomic_fetch_sub(&m->count, count);
+		removed += count;
+	}
+
+	return removed;
+}
+
+
+static void mq_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	mq_t *m = q->impl;
+	mq_entry_t *e = (mq_entry_t *) handle;
+	mq_shard_t *s = &m->shards[e->shard];
+
+	pthread_mutex_lock(&s->lock);
+
+	priqueue_update(&s->heap, e->handle);
+	shard_publish(s);
+	pthread_mutex_unlock(&s->lock);
+}
+
+
+static int mq_size(priqueue_t *q)
+{
+	mq_t *m = q->impl;
+
+	return atomic_load(&m->count);
+}
+
+
+static void mq_destroy(priqueue_t *q)
+{
+	mq_t *m = q->impl;
+
+	for(int i = 0; i < m->num_shards; i++) {
+		priqueue_destroy(&m->shards[i].heap);
+		priqueue_pool_destroy(&m->shards[i].entries);
+		pthread_mutex_destroy(&m->shards[i].lock);
+	}
+
+	free(m->shards);
+	free(m);
+	q->impl = NULL;
+}
+
+
+/**
+  Creates the shards of a relaxed queue, each a heap of entries ordered
+  by the queue's comparer on their elements. If they can not all be
+  allocated the queue has none, and every offer fails.
+ */
+void priqueue_multiqueue_set_shards(priqueue_t *q, int shards)
+{
+	mq_t *m = q->impl;
+
+	m->shards = aligned_alloc(64, shards * sizeof(mq_shard_t));
+	if(m->shards == NULL)
+		return;
+
+	for(int i = 0; i < shards; i++) {
+		priqueue_init_backend(&m->shards[i].heap, entry_cmp, PRIQUEUE_HEAP);
+
+		if(m->shards[i].heap.impl == NULL) {
+			while(--i >= 0) {
+				priqueue_destroy(&m->shards[i].heap);
+				pthread_mutex_destroy(&m->shards[i].lock);
+			}
+
+			free(m->shards);
+			m->shards = NULL;
+			return;
+		}
+
+		pthread_mutex_init(&m->shards[i].lock, NULL);
+		priqueue_pool_init(&m->shards[i].entries, sizeof(mq_entry_t));
+		atomic_init(&m->shards[i].top, NULL);
+	}
+
+	m->num_shards = shards;
+}
+
+
+const priqueue_ops_t priqueue_multiqueue_ops =
+{
+	mq_init,
+	mq_offer,
+	NULL,
+	mq_peek,
+	mq_poll,
+	NULL,
+	NULL,
+	mq_at,
+	mq_remove_at,
+	mq_remove_handle,
+	mq_find,
+	mq_remove,
+	mq_update,
+	mq_size,
+	mq_iter_begin,
+	mq_iter_next,
+	mq_iter_remove,
+	mq_iter_end,
+	NULL,
+	NULL,
+	NULL,
+	mq_destroy
+};
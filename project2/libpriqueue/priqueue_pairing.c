@@ -0,0 +1,552 @@
+/** @file priqueue_pairing.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Pairing heap backend, for queues that are merged and split.
+
+  After Fredman, Sedgewick, Sleator and Tarjan, "The Pairing Heap: A New
+  Form of Self-Adjusting Heap" (Algorithmica 1986). The heap is one tree
+  of pool nodes, each linking to its first child, its next sibling and
+  back to its previous sibling, or its parent if it is a first child.
+  Offering links a new node under the root or over it in O(1); polling
+  pairs up the root's children in two passes, O(log n) amortized. Merging
+  two queues is a single link, and the nodes and their handles move to the
+  destination with their pool slabs; only folding the smaller queue's
+  handle index into the larger's costs more, O(min(n, m)) expected.
+
+  Entries carry an insertion sequence number that puts equal elements in
+  FIFO order, as in the heap backend. A node is its element's handle, so
+  priqueue_remove_handle and priqueue_update cut its subtree out and link
+  it back in O(log n) amortized.
+
+  priqueue_at, priqueue_remove_at and cursors drain a private binary heap
+  built from a copy of the nodes, O(n + index log n).
+ */
+struct pairing_node
+{
+	void *data;
+	unsigned long seq;
+	struct pairing_node *child, *next;
+	struct pairing_node *prev;	// previous sibling, or the parent of a first child
+};
+
+// one element of a cursor's private copy
+struct pairing_entry
+{
+	void *data;
+	unsigned long seq;
+	struct pairing_node *node;
+};
+
+typedef struct _pairing_t
+{
+	struct pairing_node *root;
+	int size;
+	unsigned long next_seq;
+} pairing_t;
+
+
+/**
+  Orders by the comparer, then by sequence number. Merged queues can share
+  sequence numbers, and then the node addresses break the tie, so the
+  order stays total.
+ */
+static int pairing_less(priqueue_t *q, const struct pairing_node *a, const struct pairing_node *b)
+{
+	int diff = PRIQUEUE_CMP(q, a->data, b->data);
+
+	if(diff == 0)
+		return a->seq != b->seq ? a->seq < b->seq : a < b;
+
+	return diff < 0;
+}
+
+
+/**
+  Links two trees; the root that comes later becomes the first child of
+  the other, which is returned. Its own sibling links are left to the
+  caller.
+ */
+static struct pairing_node *pairing_link(priqueue_t *q, struct pairing_node *a, struct pairing_node *b)
+{
+	if(a == NULL)
+		return b;
+	if(b == NULL)
+		return a;
+
+	if(pairing_less(q, b, a)) {
+		struct pairing_node *swap = a;
+		a = b;
+		b = swap;
+	}
+
+	PRIQUEUE_COUNT(q, hops);
+
+	b->prev = a;
+	b->next = a->child;
+	if(a->child)
+		a->child->prev = b;
+	a->child = b;
+
+	return a;
+}
+
+
+/**
+  Combines a list of sibling trees into one: links them in pairs from the
+  left, then folds the pairs together from the right.
+ */
+static struct pairing_node *pairing_combine(priqueue_t *q, struct pairing_node *first)
+{
+	struct pairing_node *pairs = NULL, *root = NULL;
+
+	//the pairs are chained through next, last one first
+	while(first != NULL) {
+		struct pairing_node *a = first, *b = first->next;
+
+		first = b ? b->next : NULL;
+		a->next = NULL;
+		if(b)
+			b->next = NULL;
+
+		a = pairing_link(q, a, b);
+		a->next = pairs;
+		pairs = a;
+	}
+
+	while(pairs != NULL) {
+		struct pairing_node *next = pairs->next;
+
+		pairs->next = NULL;
+		root = pairing_link(q, root, pairs);
+		pairs = next;
+	}
+
+	if(root)
+		root->prev = root->next = NULL;
+
+	return root;
+}
+
+
+/**
+  Takes n, with its subtree, out of its parent's list of children.
+ */
+static void pairing_detach(struct pairing_node *n)
+{
+	if(n->prev->child == n)
+		n->prev->child = n->next;
+	else
+		n->prev->next = n->next;
+
+	if(n->next)
+		n->next->prev = n->prev;
+
+	n->next = n->prev = NULL;
+}
+
+
+/**
+  Unlinks n from the heap, keeping everything else in it.
+ */
+static void pairing_unlink(priqueue_t *q, pairing_t *p, struct pairing_node *n)
+{
+	struct pairing_node *children = n->child;
+
+	n->child = NULL;
+
+	if(n == p->root) {
+		p->root = pairing_combine(q, children);
+		return;
+	}
+
+	pairing_detach(n);
+	p->root = pairing_link(q, p->root, pairing_combine(q, children));
+}
+
+
+static void *pairing_delete(priqueue_t *q, pairing_t *p, struct pairing_node *n)
+{
+	void *value = n->data;
+
+	pairing_unlink(q, p, n);
+	p->size--;
+	priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+/**
+  Node after n in a preorder walk of the tree under top, following the
+  back links up instead of keeping a stack.
+ */
+static struct pairing_node *pairing_walk(struct pairing_node *top, struct pairing_node *n)
+{
+	if(n->child)
+		return n->child;
+
+	while(1) {
+		if(n != top && n->next)
+			return n->next;
+
+		//climb until we come up out of a first child, whose parent may have a next
+		while(1) {
+			if(n == top)
+				return NULL;
+
+			struct pairing_node *up = n->prev;
+			int from_child = up->child == n;
+
+			n = up;
+			if(from_child)
+				break;
+		}
+	}
+}
+
+
+static void pairing_init(priqueue_t *q)
+{
+	pairing_t *p = malloc(sizeof(pairing_t));
+
+	p->root = NULL;
+	p->size = 0;
+	p->next_seq = 0;
+
+	q->impl = p;
+	priqueue_pool_init(&q->pool, sizeof(struct pairing_node));
+}
+
+
+/**
+  priqueue_offer returns 0 if the element went to the front, and 1 if not.
+ */
+static int pairing_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	pairing_t *p = q->impl;
+	struct pairing_node *n = priqueue_node_new(q, ptr);
+
+	if(n == NULL)
+		return -1;
+
+	if(handle)
+		*handle = (priqueue_handle_t) n;
+
+	n->data = ptr;
+	n->seq = p->next_seq++;
+	n->child = n->next = n->prev = NULL;
+
+	p->root = pairing_link(q, p->root, n);
+	p->size++;
+
+	return p->root == n ? 0 : 1;
+}
+
+
+static void *pairing_peek(priqueue_t *q)
+{
+	pairing_t *p = q->impl;
+
+	return p->root ? p->root->data : NULL;
+}
+
+
+static void *pairing_poll(priqueue_t *q)
+{
+	pairing_t *p = q->impl;
+
+	if(p->root == NULL)
+		return NULL;
+
+	return pairing_delete(q, p, p->root);
+}
+
+
+static int entry_less(priqueue_t *q, const struct pairing_entry *a, const struct pairing_entry *b)
+{
+	int diff = PRIQUEUE_CMP(q, a->data, b->data);
+
+	if(diff == 0)
+		return a->seq != b->seq ? a->seq < b->seq : a->node < b->node;
+
+	return diff < 0;
+}
+
+
+static void order_sift_down(priqueue_t *q, struct pairing_entry *order, int size, int pos)
+{
+	struct pairing_entry e = order[pos];
+
+	while(1) {
+		int child = 2 * pos + 1;
+
+		if(child >= size)
+			break;
+
+		if(child + 1 < size && entry_less(q, &order[child + 1], &order[child]))
+			child++;
+
+		if(!entry_less(q, &order[child], &e))
+			break;
+
+		order[pos] = order[child];
+		pos = child;
+	}
+
+	order[pos] = e;
+}
+
+
+/**
+  Cursors drain a private binary heap built from a copy of the nodes,
+  which removals from the real heap leave alone.
+ */
+static void *pairing_iter_next(priqueue_iter_t *it)
+{
+	struct pairing_entry *order = it->order;
+
+	if(it->remaining == 0) {
+		it->current = NULL;
+		return NULL;
+	}
+
+	struct pairing_entry top = order[0];
+
+	order[0] = order[--it->remaining];
+	order_sift_down(it->q, order, it->remaining, 0);
+
+	it->current = (priqueue_handle_t) top.node;
+
+	return top.data;
+}
+
+
+static void *pairing_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	pairing_t *p = q->impl;
+	int i = 0;
+
+	if(p->size == 0)
+		return NULL;
+
+	struct pairing_entry *order = malloc(p->size * sizeof(struct pairing_entry));
+	if(order == NULL) {
+		it->error = 1;
+		return NULL;
+	}
+
+	for(struct pairing_node *n = p->root; n != NULL; n = pairing_walk(p->root, n)) {
+		order[i].data = n->data;
+		order[i].seq = n->seq;
+		order[i++].node = n;
+	}
+
+	for(int pos = p->size / 2 - 1; pos >= 0; pos--)
+		order_sift_down(q, order, p->size, pos);
+
+	it->order = order;
+	it->remaining = p->size;
+
+	return pairing_iter_next(it);
+}
+
+
+static void *pairing_iter_remove(priqueue_iter_t *it)
+{
+	return pairing_delete(it->q, it->q->impl, (struct pairing_node *) it->current);
+}
+
+
+/**
+  The index'th node, or NULL.
+ */
+static struct pairing_node *pairing_select(priqueue_t *q, int index)
+{
+	pairing_t *p = q->impl;
+	priqueue_iter_t it;
+
+	if(index < 0 || index >= p->size)
+		return NULL;
+
+	if(index == 0)
+		return p->root;
+
+	it.q = q;
+	it.order = NULL;
+	it.current = NULL;
+
+	//the queue is not empty, so no first element means the copy failed
+	if(pairing_iter_begin(q, &it) == NULL)
+		return NULL;
+
+	for(int i = 0; i < index; i++)
+		pairing_iter_next(&it);
+
+	free(it.order);
+
+	return (struct pairing_node *) it.current;
+}
+
+
+static void *pairing_at(priqueue_t *q, int index)
+{
+	struct pairing_node *n = pairing_select(q, index);
+
+	return n ? n->data : NULL;
+}
+
+
+static void *pairing_remove_at(priqueue_t *q, int index)
+{
+	struct pairing_node *n = pairing_select(q, index);
+
+	return n ? pairing_delete(q, q->impl, n) : NULL;
+}
+
+
+static void *pairing_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	return pairing_delete(q, q->impl, (struct pairing_node *) handle);
+}
+
+
+/**
+  Cuts the node out and links it back in by itself, keeping its sequence
+  number and so its place among equals.
+ */
+static void pairing_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	pairing_t *p = q->impl;
+	struct pairing_node *n = (struct pairing_node *) handle;
+
+	pairing_unlink(q, p, n);
+	p->root = pairing_link(q, p->root, n);
+	p->root->prev = p->root->next = NULL;
+}
+
+
+static int pairing_size(priqueue_t *q)
+{
+	pairing_t *p = q->impl;
+
+	return p->size;
+}
+
+
+/**
+  Links src's tree under or over dst's. priqueue_merge moves the pool
+  slabs the nodes live in.
+ */
+static int pairing_merge(priqueue_t *dst, priqueue_t *src)
+{
+	pairing_t *d = dst->impl, *s = src->impl;
+
+	d->root = pairing_link(dst, d->root, s->root);
+	d->size += s->size;
+	if(s->next_seq > d->next_seq)
+		d->next_seq = s->next_seq;
+
+	s->root = NULL;
+	s->size = 0;
+
+	return 0;
+}
+
+
+/**
+  Sorts every node into those that stay and those that match, re-creates
+  the matching ones in out, whose sequence numbers continue q's, and pairs
+  up each set into a tree, O(n).
+ */
+static int pairing_split(priqueue_t *q, priqueue_t *out, int (*predicate)(const void *ptr, void *arg), void *arg)
+{
+	pairing_t *p = q->impl, *o = out->impl;
+	struct pairing_node **nodes = malloc((p->size ? p->size : 1) * sizeof(struct pairing_node *));
+	struct pairing_node *stay = NULL, *moved = NULL;
+	int count = 0, i = 0;
+
+	if(nodes == NULL)
+		return -1;
+
+	for(struct pairing_node *n = p->root; n != NULL; n = pairing_walk(p->root, n))
+		nodes[i++] = n;
+
+	o->next_seq = p->next_seq;
+
+	for(i = 0; i < p->size; i++) {
+		struct pairing_node *n = nodes[i];
+
+		if(predicate(n->data, arg)) {
+			struct pairing_node *copy = priqueue_node_new(out, n->data);
+
+			//out of memory: n stays where it is
+			if(copy != NULL) {
+				copy->data = n->data;
+				copy->seq = n->seq;
+				copy->child = copy->prev = NULL;
+				copy->next = moved;
+				moved = copy;
+
+				priqueue_node_release(q, n->data, n);
+				count++;
+				continue;
+			}
+		}
+
+		n->child = n->prev = NULL;
+		n->next = stay;
+		stay = n;
+	}
+
+	free(nodes);
+
+	p->root = pairing_combine(q, stay);
+	p->size -= count;
+	o->root = pairing_combine(out, moved);
+	o->size = count;
+
+	return count;
+}
+
+
+static void pairing_destroy(priqueue_t *q)
+{
+	free(q->impl);
+
+	q->impl = NULL;
+}
+
+
+const priqueue_ops_t priqueue_pairing_ops =
+{
+	pairing_init,
+	pairing_offer,
+	NULL,
+	pairing_peek,
+	pairing_poll,
+	NULL,
+	NULL,
+	pairing_at,
+	pairing_remove_at,
+	pairing_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	pairing_update,
+	pairing_size,
+	pairing_iter_begin,
+	pairing_iter_next,
+	pairing_iter_remove,
+	NULL,
+	NULL,
+	pairing_merge,
+	pairing_split,
+	pairing_destroy
+};
@@ -0,0 +1,630 @@
+/** @file priqueue_persistent.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Persistent leftist heap backend, for queues that are cloned.
+
+  Nodes are never changed once built. An offer or poll builds new nodes
+  along the right spines it merges, O(log n) of them, and points them at
+  the untouched subtrees of the old version; removing an element from the
+  middle also copies its ancestors. priqueue_clone() therefore only takes
+  a reference to the root, and the versions share every node neither has
+  changed since. Nodes are reference counted and freed with the last
+  version that uses them. The counts are not atomic: versions that share
+  nodes must be used from one thread at a time.
+
+  Each element lives in a cell, shared by every node copied for it, which
+  holds the insertion sequence number that puts equal elements in FIFO
+  order. The cell is the element's handle, in every clone made while it is
+  queued. Nodes have no parent links, so priqueue_remove_handle() searches
+  for the element, skipping subtrees whose root is ordered after it:
+  O(log n) near the front, O(n) at worst. priqueue_update() can not skip
+  anything, as the key it would go by has changed, and neither can
+  priqueue_remove(), as it looks for an address; both are O(n).
+
+  priqueue_at, priqueue_remove_at and cursors poll a private version,
+  which costs nothing to make, O(index log n).
+ */
+struct pers_cell
+{
+	void *data;
+	unsigned long seq;
+	int refs;
+};
+
+struct pers_node
+{
+	union {
+		struct pers_cell *cell;
+		struct pers_node *dead;	// next node to free, once the node is released
+	};
+	struct pers_node *left, *right;	// the left has the longer path to a leaf
+	int rank, refs;			// rank: length of the right spine
+};
+
+struct pers_frame
+{
+	struct pers_node *node;
+	int depth;
+};
+
+typedef struct _persistent_t
+{
+	struct pers_node *root;
+	int size;
+	unsigned long next_seq;
+
+	struct pers_frame *frames;	// search stack
+	struct pers_node **path;	// path from the root to the node found
+	int frames_capacity, path_capacity;
+} persistent_t;
+
+
+/**
+  Orders by the comparer, then by sequence number, then, for cells from
+  merged queues that share one, by address.
+ */
+static int cell_less(priqueue_t *q, const struct pers_cell *a, const struct pers_cell *b)
+{
+	int diff = PRIQUEUE_CMP(q, a->data, b->data);
+
+	if(diff == 0)
+		return a->seq != b->seq ? a->seq < b->seq : a < b;
+
+	return diff < 0;
+}
+
+
+static int node_rank(const struct pers_node *n)
+{
+	return n ? n->rank : 0;
+}
+
+
+static struct pers_node *node_ref(struct pers_node *n)
+{
+	if(n)
+		n->refs++;
+
+	return n;
+}
+
+
+static void cell_release(struct pers_cell *cell)
+{
+	if(--cell->refs == 0)
+		free(cell);
+}
+
+
+/**
+  Drops one reference to n, freeing it and whatever only it used. Left
+  spines can be as long as the heap, so this works through a list of dead
+  nodes instead of recursing.
+ */
+static void node_release(priqueue_t *q, struct pers_node *n)
+{
+	struct pers_node *dead = NULL;
+
+	if(n == NULL || --n->refs > 0)
+		return;
+
+	cell_release(n->cell);
+	n->dead = NULL;
+	dead = n;
+
+	while(dead != NULL) {
+		n = dead;
+		dead = n->dead;
+
+		struct pers_node *children[2] = { n->left, n->right };
+		for(int i = 0; i < 2; i++) {
+			struct pers_node *child = children[i];
+
+			if(child != NULL && --child->refs == 0) {
+				cell_release(child->cell);
+				child->dead = dead;
+				dead = child;
+			}
+		}
+
+		free(n);
+		PRIQUEUE_COUNT(q, frees);
+	}
+}
+
+
+/**
+  Builds a node for cell over left and right, taking over the caller's
+  references to them, and puts the child with the longer right spine on
+  the left. If memory runs out the references are dropped and NULL is
+  returned.
+ */
+static struct pers_node *node_new(priqueue_t *q, struct pers_cell *cell, struct pers_node *left, struct pers_node *right)
+{
+	struct pers_node *n = malloc(sizeof(struct pers_node));
+
+	if(n == NULL) {
+		node_release(q, left);
+		node_release(q, right);
+		return NULL;
+	}
+
+	if(node_rank(left) < node_rank(right)) {
+		struct pers_node *swap = left;
+		left = right;
+		right = swap;
+	}
+
+	n->cell = cell;
+	n->left = left;
+	n->right = right;
+	n->rank = node_rank(right) + 1;
+	n->refs = 1;
+	cell->refs++;
+
+	PRIQUEUE_COUNT(q, allocs);
+
+	return n;
+}
+
+
+/**
+  Merges two versions into a new one, which the caller holds a reference
+  to. Only nodes on the right spines are copied. NULL if both are empty,
+  or if memory ran out.
+ */
+static struct pers_node *pers_merge(priqueue_t *q, struct pers_node *a, struct pers_node *b)
+{
+	if(a == NULL)
+		return node_ref(b);
+	if(b == NULL)
+		return node_ref(a);
+
+	if(cell_less(q, b->cell, a->cell)) {
+		struct pers_node *swap = a;
+		a = b;
+		b = swap;
+	}
+
+	PRIQUEUE_COUNT(q, hops);
+
+	struct pers_node *right = pers_merge(q, a->right, b);
+	if(right == NULL)
+		return NULL;
+
+	return node_new(q, a->cell, node_ref(a->left), right);
+}
+
+
+/**
+  Makes room for needed items in a search array.
+ */
+static int pers_reserve(void **array, int *capacity, int needed, size_t item_size)
+{
+	if(needed <= *capacity)
+		return 1;
+
+	int grown = *capacity ? 2 * *capacity : 64;
+	while(grown < needed)
+		grown *= 2;
+
+	void *items = realloc(*array, grown * item_size);
+	if(items == NULL)
+		return 0;
+
+	*array = items;
+	*capacity = grown;
+
+	return 1;
+}
+
+
+/**
+  Finds the node holding cell, or if cell is NULL the first one holding
+  ptr, and fills p->path with the nodes from the root down to it. With
+  prune set, subtrees whose root is ordered after cell are skipped, which
+  needs cell's key to be unchanged since it was offered.
+
+  @return the found node's depth, its index in p->path, or -1
+ */
+static int pers_find_path(priqueue_t *q, persistent_t *p, struct pers_cell *cell, void *ptr, int prune)
+{
+	int top = 0;
+
+	if(p->root == NULL || !pers_reserve((void **) &p->frames, &p->frames_capacity, 1, sizeof(struct pers_frame)))
+		return -1;
+
+	p->frames[top].node = p->root;
+	p->frames[top++].depth = 0;
+
+	//depth-first, so the last node taken at each depth is an ancestor of the current one
+	while(top > 0) {
+		struct pers_frame f = p->frames[--top];
+
+		if(!pers_reserve((void **) &p->path, &p->path_capacity, f.depth + 1, sizeof(struct pers_node *)) ||
+		   !pers_reserve((void **) &p->frames, &p->frames_capacity, top + 2, sizeof(struct pers_frame)))
+			return -1;
+
+		p->path[f.depth] = f.node;
+
+		if(cell ? f.node->cell == cell : f.node->cell->data == ptr)
+			return f.depth;
+
+		PRIQUEUE_COUNT(q, hops);
+
+		struct pers_node *children[2] = { f.node->right, f.node->left };
+		for(int i = 0; i < 2; i++) {
+			struct pers_node *child = children[i];
+
+			if(child == NULL || (prune && cell_less(q, cell, child->cell)))
+				continue;
+
+			p->frames[top].node = child;
+			p->frames[top++].depth = f.depth + 1;
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+  Builds the version without the node at p->path[depth], copying its
+  ancestors, and sets *root to it.
+
+  @return 1, or 0 if memory ran out
+ */
+static int pers_cut(priqueue_t *q, persistent_t *p, int depth, struct pers_node **root)
+{
+	struct pers_node *target = p->path[depth];
+	struct pers_node *rest = pers_merge(q, target->left, target->right);
+
+	if(rest == NULL && target->left != NULL && target->right != NULL)
+		return 0;
+
+	for(int i = depth - 1; i >= 0; i--) {
+		struct pers_node *parent = p->path[i];
+		struct pers_node *other = parent->left == p->path[i + 1] ? parent->right : parent->left;
+
+		rest = node_new(q, parent->cell, rest, node_ref(other));
+		if(rest == NULL)
+			return 0;
+	}
+
+	*root = rest;
+
+	return 1;
+}
+
+
+/**
+  Replaces the queue's version with root, whose reference it takes over.
+ */
+static void pers_commit(priqueue_t *q, persistent_t *p, struct pers_node *root)
+{
+	node_release(q, p->root);
+	p->root = root;
+}
+
+
+static void pers_init(priqueue_t *q)
+{
+	persistent_t *p = malloc(sizeof(persistent_t));
+
+	p->root = NULL;
+	p->size = 0;
+	p->next_seq = 0;
+	p->frames = NULL;
+	p->path = NULL;
+	p->frames_capacity = p->path_capacity = 0;
+
+	q->impl = p;
+}
+
+
+/**
+  priqueue_offer returns 0 if the element went to the front, and 1 if not.
+ */
+static int pers_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	persistent_t *p = q->impl;
+	struct pers_cell *cell = malloc(sizeof(struct pers_cell));
+
+	if(cell == NULL)
+		return -1;
+
+	cell->data = ptr;
+	cell->seq = p->next_seq++;
+	cell->refs = 0;
+
+	struct pers_node *single = node_new(q, cell, NULL, NULL);
+	if(single == NULL) {
+		free(cell);
+		return -1;
+	}
+
+	struct pers_node *merged = pers_merge(q, p->root, single);
+	node_release(q, single);
+
+	if(merged == NULL)
+		return -1;
+
+	pers_commit(q, p, merged);
+	p->size++;
+
+	if(handle)
+		*handle = (priqueue_handle_t) cell;
+
+	return merged->cell == cell ? 0 : 1;
+}
+
+
+static void *pers_peek(priqueue_t *q)
+{
+	persistent_t *p = q->impl;
+
+	return p->root ? p->root->cell->data : NULL;
+}
+
+
+static void *pers_poll(priqueue_t *q)
+{
+	persistent_t *p = q->impl;
+	struct pers_node *root = p->root;
+
+	if(root == NULL)
+		return NULL;
+
+	struct pers_node *rest = pers_merge(q, root->left, root->right);
+	if(rest == NULL && root->left != NULL && root->right != NULL)
+		return NULL;
+
+	void *value = root->cell->data;
+
+	pers_commit(q, p, rest);
+	p->size--;
+
+	return value;
+}
+
+
+static void *pers_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	persistent_t *p = q->impl;
+	struct pers_cell *cell = (struct pers_cell *) handle;
+	struct pers_node *root;
+	int depth = pers_find_path(q, p, cell, NULL, 1);
+
+	if(depth == -1 || !pers_cut(q, p, depth, &root))
+		return NULL;
+
+	void *value = cell->data;
+
+	pers_commit(q, p, root);
+	p->size--;
+
+	return value;
+}
+
+
+static priqueue_handle_t pers_find(priqueue_t *q, void *ptr)
+{
+	persistent_t *p = q->impl;
+	int depth = pers_find_path(q, p, NULL, ptr, 0);
+
+	return depth == -1 ? NULL : (priqueue_handle_t) p->path[depth]->cell;
+}
+
+
+/**
+  Takes the element out wherever it is and merges it back in, as the same
+  cell, so it keeps its handle and its place among equals.
+ */
+static void pers_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	persistent_t *p = q->impl;
+	struct pers_cell *cell = (struct pers_cell *) handle;
+	struct pers_node *rest;
+	int depth = pers_find_path(q, p, cell, NULL, 0);
+
+	if(depth == -1 || !pers_cut(q, p, depth, &rest))
+		return;
+
+	struct pers_node *single = node_new(q, cell, NULL, NULL);
+	struct pers_node *merged = single ? pers_merge(q, rest, single) : NULL;
+
+	node_release(q, single);
+	node_release(q, rest);
+
+	if(merged != NULL)
+		pers_commit(q, p, merged);
+}
+
+
+/**
+  The index'th cell, found by polling a private version, or NULL.
+ */
+static struct pers_cell *pers_select(priqueue_t *q, int index)
+{
+	persistent_t *p = q->impl;
+
+	if(index < 0 || index >= p->size)
+		return NULL;
+
+	struct pers_node *v = node_ref(p->root);
+
+	for(int i = 0; i < index; i++) {
+		struct pers_node *next = pers_merge(q, v->left, v->right);
+
+		if(next == NULL) {
+			node_release(q, v);
+			return NULL;
+		}
+
+		node_release(q, v);
+		v = next;
+	}
+
+	//the queue's own version still holds the cell
+	struct pers_cell *cell = v->cell;
+	node_release(q, v);
+
+	return cell;
+}
+
+
+static void *pers_at(priqueue_t *q, int index)
+{
+	struct pers_cell *cell = pers_select(q, index);
+
+	return cell ? cell->data : NULL;
+}
+
+
+static void *pers_remove_at(priqueue_t *q, int index)
+{
+	struct pers_cell *cell = pers_select(q, index);
+
+	return cell ? pers_remove_handle(q, (priqueue_handle_t) cell) : NULL;
+}
+
+
+static int pers_size(priqueue_t *q)
+{
+	persistent_t *p = q->impl;
+
+	return p->size;
+}
+
+
+/**
+  Cursors poll a private version, which removals from the queue's own
+  version leave alone.
+ */
+static void *pers_iter_next(priqueue_iter_t *it)
+{
+	struct pers_node *v = it->order;
+
+	it->current = NULL;
+
+	if(v == NULL)
+		return NULL;
+
+	struct pers_node *next = pers_merge(it->q, v->left, v->right);
+	if(next == NULL && v->left != NULL && v->right != NULL)
+		return NULL;
+
+	void *value = v->cell->data;
+
+	it->current = (priqueue_handle_t) v->cell;
+	node_release(it->q, v);
+	it->order = next;
+
+	return value;
+}
+
+
+static void *pers_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	persistent_t *p = q->impl;
+
+	it->order = node_ref(p->root);
+
+	return pers_iter_next(it);
+}
+
+
+static void *pers_iter_remove(priqueue_iter_t *it)
+{
+	return pers_remove_handle(it->q, it->current);
+}
+
+
+static void pers_iter_end(priqueue_iter_t *it)
+{
+	node_release(it->q, it->order);
+	it->order = NULL;
+}
+
+
+static int pers_clone(priqueue_t *dst, priqueue_t *src)
+{
+	persistent_t *d = dst->impl, *s = src->impl;
+
+	d->root = node_ref(s->root);
+	d->size = s->size;
+	d->next_seq = s->next_seq;
+
+	return 0;
+}
+
+
+/**
+  Merges src's version into dst's, copying only the right spines,
+  O(log n), and empties src. Cells, and with them handles, carry over.
+ */
+static int pers_meld(priqueue_t *dst, priqueue_t *src)
+{
+	persistent_t *d = dst->impl, *s = src->impl;
+	struct pers_node *merged = pers_merge(dst, d->root, s->root);
+
+	if(merged == NULL && (d->root || s->root))
+		return -1;
+
+	pers_commit(dst, d, merged);
+	d->size += s->size;
+	if(s->next_seq > d->next_seq)
+		d->next_seq = s->next_seq;
+
+	pers_commit(src, s, NULL);
+	s->size = 0;
+
+	return 0;
+}
+
+
+static void pers_destroy(priqueue_t *q)
+{
+	persistent_t *p = q->impl;
+
+	node_release(q, p->root);
+	free(p->frames);
+	free(p->path);
+	free(p);
+
+	q->impl = NULL;
+}
+
+
+const priqueue_ops_t priqueue_persistent_ops =
+{
+	pers_init,
+	pers_offer,
+	NULL,
+	pers_peek,
+	pers_poll,
+	NULL,
+	NULL,
+	pers_at,
+	pers_remove_at,
+	pers_remove_handle,
+	pers_find,
+	NULL,
+	pers_update,
+	pers_size,
+	pers_iter_begin,
+	pers_iter_next,
+	pers_iter_remove,
+	pers_iter_end,
+	pers_clone,
+	pers_meld,
+	NULL,
+	pers_destroy
+};
@@ -0,0 +1,194 @@
+/** @file priqueue_pool.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+
+#define POOL_FIRST_SLAB_OBJECTS 32
+#define POOL_MAX_SLAB_OBJECTS   4096
+
+/* Slabs are chained through a header at their start, which also records
+   how many objects the slab holds; objects follow it. */
+#define POOL_SLAB_HEADER 16
+
+
+/**
+  Prepares an empty pool handing out objects of object_size bytes. No
+  memory is allocated until the first priqueue_pool_alloc().
+
+  @param pool the pool to initialize
+  @param object_size the size of every object, in bytes
+ */
+void priqueue_pool_init(priqueue_pool_t *pool, unsigned int object_size)
+{
+	// every object must be able to hold the free list link
+	if(object_size < sizeof(void *))
+		object_size = sizeof(void *);
+
+	pool->object_size = (object_size + sizeof(void *) - 1) & ~(unsigned int)(sizeof(void *) - 1);
+	pool->next_slab_objects = POOL_FIRST_SLAB_OBJECTS;
+	pool->slabs = pool->slab_tail = NULL;
+	pool->free_list = pool->free_tail = NULL;
+	pool->live = 0;
+	pool->num_slabs = 0;
+}
+
+
+/**
+  Adds a slab to the pool and threads its objects onto the free list.
+  Slabs double in size up to POOL_MAX_SLAB_OBJECTS objects.
+ */
+static int pool_grow(priqueue_pool_t *pool)
+{
+	int count = pool->next_slab_objects;
+	char *slab = malloc(POOL_SLAB_HEADER + (size_t) count * pool->object_size);
+
+	if(slab == NULL)
+		return 0;
+
+	if(pool->slabs == NULL)
+		pool->slab_tail = slab;
+
+	*(void **) slab = pool->slabs;
+	*(int *)(slab + sizeof(void *)) = count;
+	pool->slabs = slab;
+	pool->num_slabs++;
+
+	// push in reverse so objects are handed out in address order
+	for(int i = count - 1; i >= 0; i--) {
+		void *object = slab + POOL_SLAB_HEADER + (size_t) i * pool->object_size;
+
+		if(pool->free_list == NULL)
+			pool->free_tail = object;
+
+		*(void **) object = pool->free_list;
+		pool->free_list = object;
+	}
+
+	if(pool->next_slab_objects < POOL_MAX_SLAB_OBJECTS)
+		pool->next_slab_objects *= 2;
+
+	return 1;
+}
+
+
+/**
+  Takes one object from the pool.
+
+  @param pool the pool to allocate from
+  @return an uninitialized object of the pool's object size
+  @return NULL if no memory is available
+ */
+void *priqueue_pool_alloc(priqueue_pool_t *pool)
+{
+	if(pool->free_list == NULL && !pool_grow(pool))
+		return NULL;
+
+	void *object = pool->free_list;
+	pool->free_list = *(void **) object;
+	pool->live++;
+
+	return object;
+}
+
+
+/**
+  Returns an object to the pool's free list for reuse.
+
+  @param pool the pool object was allocated from
+  @param object the object to release
+ */
+void priqueue_pool_free(priqueue_pool_t *pool, void *object)
+{
+	if(pool->free_list == NULL)
+		pool->free_tail = object;
+
+	*(void **) object = pool->free_list;
+	pool->free_list = object;
+	pool->live--;
+}
+
+
+/**
+  Tells whether object was carved out of one of the pool's slabs.
+
+  @param pool the pool to search
+  @param object any pointer
+  @return 1 if object belongs to the pool, 0 otherwise
+ */
+int priqueue_pool_owns(const priqueue_pool_t *pool, const void *object)
+{
+	for(char *slab = pool->slabs; slab != NULL; slab = *(void **) slab) {
+		int count = *(int *)(slab + sizeof(void *));
+		const char *first = slab + POOL_SLAB_HEADER;
+
+		if((const char *) object >= first && (const char *) object < first + (size_t) count * pool->object_size)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+  Hands all of src's slabs, with the objects live in them, over to pool
+  and leaves src empty. The objects on src's free list join pool's, so
+  pool reuses them. Both chains are spliced at their tails, in O(1). Both
+  pools must have the same object size.
+
+  @param pool the pool to take the slabs
+  @param src the pool to empty
+ */
+void priqueue_pool_merge(priqueue_pool_t *pool, priqueue_pool_t *src)
+{
+	if(src->slabs == NULL)
+		return;
+
+	if(pool->slabs == NULL)
+		pool->slab_tail = src->slab_tail;
+
+	*(void **) src->slab_tail = pool->slabs;
+	pool->slabs = src->slabs;
+	pool->num_slabs += src->num_slabs;
+	pool->live += src->live;
+
+	if(src->next_slab_objects > pool->next_slab_objects)
+		pool->next_slab_objects = src->next_slab_objects;
+
+	if(src->free_list != NULL) {
+		if(pool->free_list == NULL)
+			pool->free_tail = src->free_tail;
+
+		*(void **) src->free_tail = pool->free_list;
+		pool->free_list = src->free_list;
+	}
+
+	src->slabs = src->slab_tail = NULL;
+	src->free_list = src->free_tail = NULL;
+	src->live = 0;
+	src->num_slabs = 0;
+}
+
+
+/**
+  Releases every slab at once, including objects that are still live.
+
+  @param pool the pool to destroy
+ */
+void priqueue_pool_destroy(priqueue_pool_t *pool)
+{
+	void *slab = pool->slabs;
+
+	while(slab != NULL) {
+		void *next = *(void **) slab;
+		free(slab);
+		slab = next;
+	}
+
+	pool->slabs = pool->slab_tail = NULL;
+	pool->free_list = pool->free_tail = NULL;
+	pool->live = 0;
+	pool->num_slabs = 0;
+}
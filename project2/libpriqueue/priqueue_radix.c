@@ -0,0 +1,384 @@
+/** @file priqueue_radix.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "priqueue_internal.h"
+
+
+/**
+  Radix heap backend, for unsigned 64-bit keys that are polled in
+  non-decreasing order, such as event times in a simulation.
+
+  Bucket 0 holds elements whose key equals the last polled key; bucket i
+  holds those whose key first differs from it in bit i - 1. When bucket 0
+  runs dry, the lowest non-empty bucket is scanned for its smallest key,
+  which becomes the new last key, and its elements are spread over the
+  lower buckets. Each element can only move down, so poll is O(log C)
+  amortized for keys spanning C values, and offer is O(1).
+
+  Keys may never be offered (or updated) below the last polled key; debug
+  builds assert this. Equal keys leave in FIFO order: buckets are FIFO
+  lists and an element always shares its bucket with every other element
+  of the same key. The comparer is not consulted, so the key alone must
+  decide the order.
+
+  priqueue_at, priqueue_remove_at and cursors sort a copy of the nodes,
+  O(n log n).
+ */
+#define RADIX_BUCKETS 65
+
+typedef struct _radix_node_t
+{
+	void *data;
+	unsigned long long key;
+	unsigned long seq;
+	struct _radix_node_t *prev, *next;
+	int bucket;
+} radix_node_t;
+
+typedef struct _radix_list_t
+{
+	radix_node_t *head, *tail;
+} radix_list_t;
+
+typedef struct _radix_t
+{
+	unsigned long long (*key)(const void *);
+	unsigned long long last;
+	unsigned long next_seq;
+	radix_list_t buckets[RADIX_BUCKETS];
+	int count;
+} radix_t;
+
+
+static int radix_bucket(radix_t *r, unsigned long long key)
+{
+	if(key == r->last)
+		return 0;
+
+	return 64 - __builtin_clzll(key ^ r->last);
+}
+
+
+static void radix_append(radix_t *r, radix_node_t *n, int bucket)
+{
+	radix_list_t *list = &r->buckets[bucket];
+
+	n->bucket = bucket;
+	n->next = NULL;
+	n->prev = list->tail;
+
+	if(list->tail)
+		list->tail->next = n;
+	else
+		list->head = n;
+
+	list->tail = n;
+}
+
+
+static void radix_unlink(radix_t *r, radix_node_t *n)
+{
+	radix_list_t *list = &r->buckets[n->bucket];
+
+	if(n->prev)
+		n->prev->next = n->next;
+	else
+		list->head = n->next;
+
+	if(n->next)
+		n->next->prev = n->prev;
+	else
+		list->tail = n->prev;
+}
+
+
+static void radix_link(radix_t *r, radix_node_t *n)
+{
+	n->key = r->key(n->data);
+	n->seq = r->next_seq++;
+
+	assert(n->key >= r->last && "radix heap keys must not go below the last polled key");
+
+	radix_append(r, n, radix_bucket(r, n->key));
+}
+
+
+static void radix_init(priqueue_t *q)
+{
+	radix_t *r = calloc(1, sizeof(radix_t));
+
+	// the key function is set by priqueue_radix_set_key()
+	q->impl = r;
+	priqueue_pool_init(&q->pool, sizeof(radix_node_t));
+}
+
+
+static int radix_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	radix_t *r = q->impl;
+	radix_node_t *n = priqueue_node_new(q, ptr);
+
+	if(n == NULL)
+		return -1;
+
+	n->data = ptr;
+	radix_link(r, n);
+	r->count++;
+
+	if(handle)
+		*handle = (priqueue_handle_t) n;
+
+	return n->bucket;
+}
+
+
+/**
+  The lowest non-empty bucket, or -1.
+ */
+static int radix_lowest(radix_t *r)
+{
+	for(int i = 0; i < RADIX_BUCKETS; i++)
+		if(r->buckets[i].head != NULL)
+			return i;
+
+	return -1;
+}
+
+
+/**
+  First node with the smallest key in bucket i.
+ */
+static radix_node_t *radix_min(radix_t *r, int i)
+{
+	radix_node_t *min = r->buckets[i].head;
+
+	//bucket 0 only holds the last key
+	if(i > 0)
+		for(radix_node_t *n = min->next; n != NULL; n = n->next)
+			if(n->key < min->key)
+				min = n;
+
+	return min;
+}
+
+
+static void *radix_peek(priqueue_t *q)
+{
+	radix_t *r = q->impl;
+	int i = radix_lowest(r);
+
+	return i == -1 ? NULL : radix_min(r, i)->data;
+}
+
+
+static void *radix_poll(priqueue_t *q)
+{
+	radix_t *r = q->impl;
+	int i = radix_lowest(r);
+
+	if(i == -1)
+		return NULL;
+
+	if(i > 0) {
+		//advance to the bucket's smallest key and spread the bucket out
+		radix_node_t *n = r->buckets[i].head;
+
+		r->last = radix_min(r, i)->key;
+		r->buckets[i].head = r->buckets[i].tail = NULL;
+
+		while(n != NULL) {
+			radix_node_t *next = n->next;
+
+			PRIQUEUE_COUNT(q, hops);
+			radix_append(r, n, radix_bucket(r, n->key));
+			n = next;
+		}
+	}
+
+	radix_node_t *n = r->buckets[0].head;
+	void *value = n->data;
+
+	radix_unlink(r, n);
+	r->count--;
+	priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+static int radix_order(const void *a, const void *b)
+{
+	const radix_node_t *x = *(radix_node_t * const *) a;
+	const radix_node_t *y = *(radix_node_t * const *) b;
+
+	if(x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+
+	return x->seq < y->seq ? -1 : (x->seq > y->seq);
+}
+
+
+/**
+  Every node, in queue order, in a new NULL-terminated array.
+ */
+static radix_node_t **radix_sorted(radix_t *r)
+{
+	radix_node_t **nodes = malloc((r->count + 1) * sizeof(radix_node_t *));
+	int count = 0;
+
+	for(int i = 0; i < RADIX_BUCKETS; i++)
+		for(radix_node_t *n = r->buckets[i].head; n != NULL; n = n->next)
+			nodes[count++] = n;
+
+	qsort(nodes, count, sizeof(radix_node_t *), radix_order);
+	nodes[count] = NULL;
+
+	return nodes;
+}
+
+
+static radix_node_t *radix_node_at(radix_t *r, int index)
+{
+	if(index < 0 || index >= r->count)
+		return NULL;
+
+	radix_node_t **nodes = radix_sorted(r);
+	radix_node_t *n = nodes[index];
+
+	free(nodes);
+
+	return n;
+}
+
+
+static void *radix_at(priqueue_t *q, int index)
+{
+	radix_node_t *n = radix_node_at(q->impl, index);
+
+	return n ? n->data : NULL;
+}
+
+
+static void *radix_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	radix_t *r = q->impl;
+	radix_node_t *n = (radix_node_t *) handle;
+	void *value = n->data;
+
+	radix_unlink(r, n);
+	r->count--;
+	priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+static void *radix_remove_at(priqueue_t *q, int index)
+{
+	radix_node_t *n = radix_node_at(q->impl, index);
+
+	if(n == NULL)
+		return NULL;
+
+	return radix_remove_handle(q, (priqueue_handle_t) n);
+}
+
+
+static void radix_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	radix_t *r = q->impl;
+	radix_node_t *n = (radix_node_t *) handle;
+
+	radix_unlink(r, n);
+	radix_link(r, n);
+}
+
+
+static int radix_size(priqueue_t *q)
+{
+	radix_t *r = q->impl;
+
+	return r->count;
+}
+
+
+/**
+  Cursors walk a sorted copy of the nodes; it->remaining is the position
+  of the next one.
+ */
+static void *radix_iter_next(priqueue_iter_t *it)
+{
+	radix_node_t **nodes = it->order;
+	radix_node_t *n = nodes[it->remaining];
+
+	if(n != NULL)
+		it->remaining++;
+
+	it->current = (priqueue_handle_t) n;
+
+	return n ? n->data : NULL;
+}
+
+
+static void *radix_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	it->order = radix_sorted(q->impl);
+
+	return radix_iter_next(it);
+}
+
+
+static void *radix_iter_remove(priqueue_iter_t *it)
+{
+	return radix_remove_handle(it->q, it->current);
+}
+
+
+static void radix_destroy(priqueue_t *q)
+{
+	//the nodes go back with the pool's slabs
+	free(q->impl);
+	q->impl = NULL;
+}
+
+
+/**
+  Sets the function that gives each element its key.
+ */
+void priqueue_radix_set_key(priqueue_t *q, unsigned long long (*key)(const void *))
+{
+	radix_t *r = q->impl;
+
+	r->key = key;
+}
+
+
+const priqueue_ops_t priqueue_radix_ops =
+{
+	radix_init,
+	radix_offer,
+	NULL,
+	radix_peek,
+	radix_poll,
+	NULL,
+	NULL,
+	radix_at,
+	radix_remove_at,
+	radix_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	radix_update,
+	radix_size,
+	radix_iter_begin,
+	radix_iter_next,
+	radix_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	radix_destroy
+};
@@ -0,0 +1,35 @@
+/** @file priqueue_shim.h
+ */
+
+#ifndef PRIQUEUE_SHIM_H_
+#define PRIQUEUE_SHIM_H_
+
+/**
+  C interface to a PriQueue specialization (see priqueue.hpp).
+
+  PRIQUEUE_SHIM_DECLARE(name) declares an opaque name_t and name_create,
+  name_offer, name_peek, name_poll, name_at, name_remove, name_remove_at,
+  name_size and name_destroy, with the same meaning as the priqueue_*
+  functions. A C++ source file provides them with
+  PRIQUEUE_SHIM_DEFINE(name, Compare), which fixes the comparator at
+  compile time.
+*/
+#ifdef __cplusplus
+#define PRIQUEUE_SHIM_LINKAGE extern "C"
+#else
+#define PRIQUEUE_SHIM_LINKAGE
+#endif
+
+#define PRIQUEUE_SHIM_DECLARE(name) \
+	typedef struct name##_s name##_t; \
+	PRIQUEUE_SHIM_LINKAGE name##_t *name##_create   (void); \
+	PRIQUEUE_SHIM_LINKAGE void      name##_destroy  (name##_t *q); \
+	PRIQUEUE_SHIM_LINKAGE int       name##_offer    (name##_t *q, void *ptr); \
+	PRIQUEUE_SHIM_LINKAGE void *    name##_peek     (name##_t *q); \
+	PRIQUEUE_SHIM_LINKAGE void *    name##_poll     (name##_t *q); \
+	PRIQUEUE_SHIM_LINKAGE void *    name##_at       (name##_t *q, int index); \
+	PRIQUEUE_SHIM_LINKAGE int       name##_remove   (name##_t *q, void *ptr); \
+	PRIQUEUE_SHIM_LINKAGE void *    name##_remove_at(name##_t *q, int index); \
+	PRIQUEUE_SHIM_LINKAGE int       name##_size     (name##_t *q)
+
+#endif /* PRIQUEUE_SHIM_H_ */
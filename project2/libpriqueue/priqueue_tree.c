@@ -0,0 +1,313 @@
+/** @file priqueue_tree.c
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "priqueue_internal.h"
+#include "pqtree.h"
+
+
+/**
+  Order-statistic tree backend, built on the intrusive treap in pqtree.h.
+
+  Every node stores the size of its subtree, which gives
+  priqueue_at/priqueue_remove_at in O(log n) by walking down from the
+  root, and the root's size answers priqueue_size in O(1).
+
+  The plain tree backend takes its nodes from the queue's pool and points
+  them at the element. The intrusive variant (priqueue_init_intrusive) uses
+  a struct pq_node embedded in the element itself, so offer and poll
+  allocate nothing and the element is found by offset, not by pointer.
+  Either way a handle is the element's struct pq_node.
+ */
+struct tree_node
+{
+	struct pq_node node;	// first, so a tree_node and its pq_node share an address
+	void *data;
+};
+
+typedef struct _tree_t
+{
+	struct pq_root root;
+	int intrusive;
+	unsigned long offset;	// of the pq_node inside each element, when intrusive
+} tree_t;
+
+
+static void *tree_data(tree_t *t, struct pq_node *n)
+{
+	if(t->intrusive)
+		return (char *) n - t->offset;
+
+	return ((struct tree_node *) n)->data;
+}
+
+
+static int tree_cmp(const struct pq_node *a, const struct pq_node *b, void *arg)
+{
+	priqueue_t *q = arg;
+
+	//pqtree.h compares once per node it steps through
+	PRIQUEUE_COUNT(q, hops);
+
+	return PRIQUEUE_CMP(q, ((const struct tree_node *) a)->data, ((const struct tree_node *) b)->data);
+}
+
+
+static int intrusive_cmp(const struct pq_node *a, const struct pq_node *b, void *arg)
+{
+	priqueue_t *q = arg;
+	tree_t *t = q->impl;
+
+	PRIQUEUE_COUNT(q, hops);
+
+	return PRIQUEUE_CMP(q, (const char *) a - t->offset, (const char *) b - t->offset);
+}
+
+
+/**
+  Removes n from the tree and, unless intrusive, returns its node to the pool.
+ */
+static void *tree_unlink(priqueue_t *q, struct pq_node *n)
+{
+	tree_t *t = q->impl;
+	void *value = tree_data(t, n);
+
+	pq_erase(n, &t->root);
+
+	if(!t->intrusive)
+		priqueue_node_release(q, value, n);
+
+	return value;
+}
+
+
+static void tree_init(priqueue_t *q)
+{
+	tree_t *t = malloc(sizeof(tree_t));
+
+	pq_root_init(&t->root, tree_cmp, q);
+	t->intrusive = 0;
+	t->offset = 0;
+
+	q->impl = t;
+	priqueue_pool_init(&q->pool, sizeof(struct tree_node));
+}
+
+
+static void intrusive_init(priqueue_t *q)
+{
+	tree_t *t = malloc(sizeof(tree_t));
+
+	// the offset is filled in by priqueue_init_intrusive()
+	pq_root_init(&t->root, intrusive_cmp, q);
+	t->intrusive = 1;
+	t->offset = 0;
+
+	q->impl = t;
+}
+
+
+static int tree_offer(priqueue_t *q, void *ptr, priqueue_handle_t *handle)
+{
+	tree_t *t = q->impl;
+	struct pq_node *n;
+
+	if(t->intrusive) {
+		n = (struct pq_node *)((char *) ptr + t->offset);
+	}
+	else {
+		struct tree_node *insert = priqueue_node_new(q, ptr);
+
+		if(insert == NULL)
+			return -1;
+
+		insert->data = ptr;
+		n = &insert->node;
+	}
+
+	if(handle)
+		*handle = (priqueue_handle_t) n;
+
+	return pq_insert(n, &t->root);
+}
+
+
+static void *tree_peek(priqueue_t *q)
+{
+	tree_t *t = q->impl;
+	struct pq_node *n = pq_first(&t->root);
+
+	return n ? tree_data(t, n) : NULL;
+}
+
+
+static void *tree_poll(priqueue_t *q)
+{
+	tree_t *t = q->impl;
+	struct pq_node *n = pq_first(&t->root);
+
+	return n ? tree_unlink(q, n) : NULL;
+}
+
+
+static void *tree_at(priqueue_t *q, int index)
+{
+	tree_t *t = q->impl;
+	struct pq_node *n = pq_at(&t->root, index);
+
+	return n ? tree_data(t, n) : NULL;
+}
+
+
+static void *tree_remove_at(priqueue_t *q, int index)
+{
+	tree_t *t = q->impl;
+	struct pq_node *n = pq_at(&t->root, index);
+
+	return n ? tree_unlink(q, n) : NULL;
+}
+
+
+static void *tree_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+	return tree_unlink(q, (struct pq_node *) handle);
+}
+
+
+/**
+  An element holds at most one embedded node, so it is queued at most once
+  and its handle is found by offset.
+ */
+static priqueue_handle_t intrusive_find(priqueue_t *q, void *ptr)
+{
+	tree_t *t = q->impl;
+	struct pq_node *n = (struct pq_node *)((char *) ptr + t->offset);
+
+	return pq_node_queued(n) ? (priqueue_handle_t) n : NULL;
+}
+
+
+static void tree_update(priqueue_t *q, priqueue_handle_t handle)
+{
+	tree_t *t = q->impl;
+
+	pq_update((struct pq_node *) handle, &t->root);
+}
+
+
+static int tree_size(priqueue_t *q)
+{
+	tree_t *t = q->impl;
+
+	return pq_size(&t->root);
+}
+
+
+static void *tree_iter_begin(priqueue_t *q, priqueue_iter_t *it)
+{
+	tree_t *t = q->impl;
+	struct pq_node *n = pq_first(&t->root);
+
+	it->current = (priqueue_handle_t) n;
+
+	return n ? tree_data(t, n) : NULL;
+}
+
+
+static void *tree_iter_next(priqueue_iter_t *it)
+{
+	tree_t *t = it->q->impl;
+	struct pq_node *n = (struct pq_node *) it->current;
+
+	//after a removal the successor was saved before the node went away
+	n = n ? pq_next(n) : (struct pq_node *) it->next;
+
+	it->current = (priqueue_handle_t) n;
+	it->next = NULL;
+
+	return n ? tree_data(t, n) : NULL;
+}
+
+
+static void *tree_iter_remove(priqueue_iter_t *it)
+{
+	struct pq_node *n = (struct pq_node *) it->current;
+
+	it->next = (priqueue_handle_t) pq_next(n);
+
+	return tree_unlink(it->q, n);
+}
+
+
+static void tree_destroy(priqueue_t *q)
+{
+	//pool nodes go back with the pool's slabs; embedded ones belong to the caller
+	free(q->impl);
+	q->impl = NULL;
+}
+
+
+/**
+  Sets the offset of the embedded struct pq_node for an intrusive queue.
+ */
+void priqueue_tree_set_offset(priqueue_t *q, unsigned long offset)
+{
+	tree_t *t = q->impl;
+
+	t->offset = offset;
+}
+
+
+const priqueue_ops_t priqueue_tree_ops =
+{
+	tree_init,
+	tree_offer,
+	NULL,
+	tree_peek,
+	tree_poll,
+	NULL,
+	NULL,
+	tree_at,
+	tree_remove_at,
+	tree_remove_handle,
+	priqueue_index_lookup,
+	NULL,
+	tree_update,
+	tree_size,
+	tree_iter_begin,
+	tree_iter_next,
+	tree_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	tree_destroy
+};
+
+const priqueue_ops_t priqueue_intrusive_ops =
+{
+	intrusive_init,
+	tree_offer,
+	NULL,
+	tree_peek,
+	tree_poll,
+	NULL,
+	NULL,
+	tree_at,
+	tree_remove_at,
+	tree_remove_handle,
+	intrusive_find,
+	NULL,
+	tree_update,
+	tree_size,
+	tree_iter_begin,
+	tree_iter_next,
+	tree_iter_remove,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	tree_destroy
+};
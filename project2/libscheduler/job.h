@@ -0,0 +1,128 @@
+/** @file job.h
+ */
+
+#ifndef JOB_H_
+#define JOB_H_
+
+#include "../libpriqueue/libpriqueue.h"
+#include "../libpriqueue/pqtree.h"
+
+/**
+  Stores information making up a job to be scheduled including any statistics.
+
+  You may need to define some global variables or a struct to store your job queue elements. 
+*/
+
+typedef struct _job_t {
+  int job_id, core_id;
+  int arrival_time, run_time, priority;
+  int time_remaining, pause_time;
+  int responded;
+  int seq;	//when the job last joined the queue, for FIFO ties
+  int end_time;	//while running, when the job would finish if it kept its core
+  priqueue_handle_t handle, run_handle;
+  struct pq_node node;
+} job_t;
+
+/* COMPARISON FUNCTIONS
+
+   Defined here, inline, so the C++ PriQueue specializations in jobqueue.cpp
+   can inline them as compile-time comparators. */
+
+static inline int FCFS_COMPARE(const void *a, const void *b) {
+	job_t* jobA = (job_t*) a;
+	job_t* jobB = (job_t*) b;
+
+	return jobA->arrival_time - jobB->arrival_time;
+}
+
+static inline int SJF_COMPARE(const void *a, const void *b) {
+	job_t* jobA = (job_t*) a;
+	job_t* jobB = (job_t*) b;
+
+	int diff = jobA->run_time -jobB->run_time;
+
+	if(diff == 0) {
+		diff = jobA->arrival_time - jobB->arrival_time;
+	}
+
+	return diff;
+}
+
+static inline int PSJF_COMPARE(const void *a, const void *b) {
+	job_t* jobA = (job_t*) a;
+	job_t* jobB = (job_t*) b;
+
+	int diff = jobA->time_remaining - jobB->time_remaining;
+
+	if(diff == 0) {
+		diff = jobA->arrival_time - jobB->arrival_time;
+	}
+
+	return diff;
+}
+
+//Running jobs under PSJF, by when each would finish: the same order as
+//PSJF_COMPARE at any one time, but fixed for as long as the jobs run
+static inline int PSJF_END_COMPARE(const void *a, const void *b) {
+	job_t* jobA = (job_t*) a;
+	job_t* jobB = (job_t*) b;
+
+	int diff = jobA->end_time - jobB->end_time;
+
+	if(diff == 0) {
+		diff = jobA->arrival_time - jobB->arrival_time;
+	}
+
+	return diff;
+}
+
+static inline int PRI_COMPARE(const void *a, const void *b) {
+	job_t* jobA = (job_t*) a;
+	job_t* jobB = (job_t*) b;
+
+	int diff = jobA->priority - jobB->priority;
+
+	if(diff == 0) {
+		diff = jobA->arrival_time - jobB->arrival_time;
+	}
+
+	return diff;
+}
+
+//Every job ties, so the queue's FIFO tie order gives round robin
+static inline int RR_COMPARE(const void *a, const void *b) {
+  return 0;
+}
+
+/* KEY FUNCTIONS
+
+   Integer keys for the bucket queue; each agrees with the comparison
+   function of the same name. */
+
+static inline int FCFS_KEY(const void *a) {
+	return ((const job_t*) a)->arrival_time;
+}
+
+static inline int PRI_KEY(const void *a) {
+	return ((const job_t*) a)->priority;
+}
+
+/* Cached 64-bit keys for the key-cached queue: the field the comparison
+   function of the same name looks at first in the high half, the arrival
+   time in the low half. Flipping the sign bits keeps negative values in
+   order. */
+
+static inline unsigned long long JOB_KEY64(int first, int arrival) {
+	return ((unsigned long long)((unsigned int) first ^ 0x80000000u) << 32) | ((unsigned int) arrival ^ 0x80000000u);
+}
+
+static inline unsigned long long SJF_KEY64(const void *a) {
+	return JOB_KEY64(((const job_t*) a)->run_time, ((const job_t*) a)->arrival_time);
+}
+
+static inline unsigned long long PSJF_KEY64(const void *a) {
+	return JOB_KEY64(((const job_t*) a)->time_remaining, ((const job_t*) a)->arrival_time);
+}
+
+#endif /* JOB_H_ */
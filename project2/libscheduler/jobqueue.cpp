@@ -0,0 +1,12 @@
+/** @file jobqueue.cpp
+ */
+
+#include "jobqueue.h"
+#include "job.h"
+#include "../libpriqueue/priqueue.hpp"
+
+PRIQUEUE_SHIM_DEFINE(fcfs_queue, CompareFn<FCFS_COMPARE>)
+PRIQUEUE_SHIM_DEFINE(sjf_queue,  CompareFn<SJF_COMPARE>)
+PRIQUEUE_SHIM_DEFINE(psjf_queue, CompareFn<PSJF_COMPARE>)
+PRIQUEUE_SHIM_DEFINE(pri_queue,  CompareFn<PRI_COMPARE>)
+PRIQUEUE_SHIM_DEFINE(rr_queue,   CompareFn<RR_COMPARE>)
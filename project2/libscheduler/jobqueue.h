@@ -0,0 +1,20 @@
+/** @file jobqueue.h
+ */
+
+#ifndef JOBQUEUE_H_
+#define JOBQUEUE_H_
+
+#include "../libpriqueue/priqueue_shim.h"
+
+/**
+  Job queues specialized per scheduling scheme. Each is a C++ PriQueue with
+  that scheme's comparer from job.h inlined at compile time, reached from C
+  through the shim functions (e.g. sjf_queue_offer, sjf_queue_poll).
+*/
+PRIQUEUE_SHIM_DECLARE(fcfs_queue);
+PRIQUEUE_SHIM_DECLARE(sjf_queue);
+PRIQUEUE_SHIM_DECLARE(psjf_queue);
+PRIQUEUE_SHIM_DECLARE(pri_queue);
+PRIQUEUE_SHIM_DECLARE(rr_queue);
+
+#endif /* JOBQUEUE_H_ */
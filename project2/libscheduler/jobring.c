@@ -0,0 +1,146 @@
+/** @file jobring.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jobring.h"
+
+#define JOBRING_MIN_CAPACITY 16
+
+#ifdef PRIQUEUE_STATS
+#define JOBRING_COUNT(ring, counter) ((void) (ring)->stats.counter++)
+#else
+#define JOBRING_COUNT(ring, counter) ((void) 0)
+#endif
+
+
+void jobring_init(jobring_t *ring)
+{
+	ring->slots = NULL;
+	ring->head = 0;
+	ring->count = 0;
+	ring->capacity = 0;
+#ifdef PRIQUEUE_STATS
+	memset(&ring->stats, 0, sizeof(ring->stats));
+#endif
+}
+
+
+/**
+  Moves the jobs to a buffer twice the size, unwrapped so the oldest is
+  at slot 0.
+ */
+static int jobring_grow(jobring_t *ring)
+{
+	unsigned int capacity = ring->capacity ? 2 * ring->capacity : JOBRING_MIN_CAPACITY;
+	job_t **slots = malloc(capacity * sizeof(job_t *));
+
+	if(slots == NULL)
+		return 0;
+
+	unsigned int first = ring->capacity - ring->head;
+
+	if(first > ring->count)
+		first = ring->count;
+
+	if(ring->count > 0) {
+		memcpy(slots, ring->slots + ring->head, first * sizeof(job_t *));
+		memcpy(slots + first, ring->slots, (ring->count - first) * sizeof(job_t *));
+	}
+
+	free(ring->slots);
+	ring->slots = slots;
+	ring->head = 0;
+	ring->capacity = capacity;
+
+	return 1;
+}
+
+
+/**
+  Adds job behind every job already queued.
+
+  @return 0 if the buffer could not grow, 1 otherwise
+ */
+int jobring_push(jobring_t *ring, job_t *job)
+{
+	JOBRING_COUNT(ring, calls[PRIQUEUE_OP_OFFER]);
+
+	if(ring->count == ring->capacity && !jobring_grow(ring))
+		return 0;
+
+	ring->slots[(ring->head + ring->count) & (ring->capacity - 1)] = job;
+	ring->count++;
+
+#ifdef PRIQUEUE_STATS
+	ring->stats.size = ring->count;
+	if(ring->stats.peak_size < ring->stats.size)
+		ring->stats.peak_size = ring->stats.size;
+#endif
+
+	return 1;
+}
+
+
+/**
+  Takes the oldest job out of the queue.
+
+  @return the job, or NULL if the queue is empty
+ */
+job_t *jobring_pop(jobring_t *ring)
+{
+	JOBRING_COUNT(ring, calls[PRIQUEUE_OP_POLL]);
+
+	if(ring->count == 0)
+		return NULL;
+
+	job_t *job = ring->slots[ring->head];
+
+	ring->head = (ring->head + 1) & (ring->capacity - 1);
+	ring->count--;
+#ifdef PRIQUEUE_STATS
+	ring->stats.size = ring->count;
+#endif
+
+	return job;
+}
+
+
+/**
+  Returns the index'th oldest job, or NULL.
+ */
+job_t *jobring_at(const jobring_t *ring, unsigned int index)
+{
+	if(index >= ring->count)
+		return NULL;
+
+	return ring->slots[(ring->head + index) & (ring->capacity - 1)];
+}
+
+
+/**
+  Copies out the ring's counters, as priqueue_stats() does for a queue.
+
+  @return 1 if the counters are kept, 0 if not
+ */
+int jobring_stats(const jobring_t *ring, priqueue_stats_t *stats)
+{
+#ifdef PRIQUEUE_STATS
+	*stats = ring->stats;
+	return 1;
+#else
+	memset(stats, 0, sizeof(*stats));
+	return 0;
+#endif
+}
+
+
+/**
+  Frees the buffer, but not the jobs in it.
+ */
+void jobring_destroy(jobring_t *ring)
+{
+	free(ring->slots);
+	jobring_init(ring);
+}
@@ -0,0 +1,29 @@
+/** @file jobring.h
+ */
+
+#ifndef JOBRING_H_
+#define JOBRING_H_
+
+#include "job.h"
+
+/**
+  First-in first-out queue of jobs in a circular buffer, for round robin,
+  where every job ties and the order is just the order of arrival. The
+  buffer's capacity is a power of two and doubles when it fills.
+*/
+typedef struct _jobring_t {
+	job_t **slots;
+	unsigned int head, count, capacity;
+#ifdef PRIQUEUE_STATS
+	priqueue_stats_t stats;	//pushes count as offers, pops as polls
+#endif
+} jobring_t;
+
+void   jobring_init   (jobring_t *ring);
+int    jobring_push   (jobring_t *ring, job_t *job);
+job_t *jobring_pop    (jobring_t *ring);
+job_t *jobring_at     (const jobring_t *ring, unsigned int index);
+int    jobring_stats  (const jobring_t *ring, priqueue_stats_t *stats);
+void   jobring_destroy(jobring_t *ring);
+
+#endif /* JOBRING_H_ */
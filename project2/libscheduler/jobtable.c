@@ -0,0 +1,168 @@
+/** @file jobtable.c
+ */
+
+#include <stdlib.h>
+
+#include "jobtable.h"
+
+#define JOBTABLE_MIN_CAPACITY 16
+
+
+static unsigned int jobtable_hash(const jobtable_t *table, int job_id)
+{
+	// the low bits of a product with an odd constant only depend on the id's
+	// low bits, and permute them, so consecutive ids never share a slot
+	unsigned int h = (unsigned int) job_id * 2654435769u;
+
+	return h & (table->capacity - 1);
+}
+
+
+void jobtable_init(jobtable_t *table)
+{
+	table->slots = NULL;
+	table->capacity = 0;
+	table->count = 0;
+}
+
+
+static int jobtable_grow(jobtable_t *table)
+{
+	job_t **old = table->slots;
+	unsigned int old_capacity = table->capacity;
+	unsigned int capacity = old_capacity ? 2 * old_capacity : JOBTABLE_MIN_CAPACITY;
+
+	job_t **slots = calloc(capacity, sizeof(job_t *));
+
+	if(slots == NULL)
+		return 0;
+
+	table->slots = slots;
+	table->capacity = capacity;
+
+	for(unsigned int i = 0; i < old_capacity; i++) {
+		if(old[i] == NULL)
+			continue;
+
+		unsigned int slot = jobtable_hash(table, old[i]->job_id);
+		while(slots[slot] != NULL)
+			slot = (slot + 1) & (capacity - 1);
+		slots[slot] = old[i];
+	}
+
+	free(old);
+
+	return 1;
+}
+
+
+/**
+  Adds job, whose job_id must not be in the table already.
+
+  @return 0 if the table could not grow, 1 otherwise
+ */
+int jobtable_insert(jobtable_t *table, job_t *job)
+{
+	if(2 * (table->count + 1) > table->capacity && !jobtable_grow(table))
+		return 0;
+
+	unsigned int slot = jobtable_hash(table, job->job_id);
+	while(table->slots[slot] != NULL)
+		slot = (slot + 1) & (table->capacity - 1);
+
+	table->slots[slot] = job;
+	table->count++;
+
+	return 1;
+}
+
+
+static int jobtable_slot(const jobtable_t *table, int job_id)
+{
+	if(table->count == 0)
+		return -1;
+
+	unsigned int slot = jobtable_hash(table, job_id);
+
+	while(table->slots[slot] != NULL) {
+		if(table->slots[slot]->job_id == job_id)
+			return slot;
+
+		slot = (slot + 1) & (table->capacity - 1);
+	}
+
+	return -1;
+}
+
+
+/**
+  Returns the job with job_id, or NULL.
+ */
+job_t *jobtable_find(const jobtable_t *table, int job_id)
+{
+	int slot = jobtable_slot(table, job_id);
+
+	return slot == -1 ? NULL : table->slots[slot];
+}
+
+
+/**
+  Takes the job with job_id out of the table.
+
+  @return the job, or NULL if it was not there
+ */
+job_t *jobtable_remove(jobtable_t *table, int job_id)
+{
+	int found = jobtable_slot(table, job_id);
+
+	if(found == -1)
+		return NULL;
+
+	unsigned int mask = table->capacity - 1;
+	unsigned int hole = found;
+	unsigned int next = (hole + 1) & mask;
+	job_t *job = table->slots[hole];
+
+	table->count--;
+
+	// shift back any later job of this cluster that the hole now hides
+	while(table->slots[next] != NULL) {
+		unsigned int home = jobtable_hash(table, table->slots[next]->job_id);
+
+		// move unless home lies cyclically in (hole, next]
+		if(((next - home) & mask) >= ((next - hole) & mask)) {
+			table->slots[hole] = table->slots[next];
+			hole = next;
+		}
+
+		next = (next + 1) & mask;
+	}
+
+	table->slots[hole] = NULL;
+
+	return job;
+}
+
+
+/**
+  Frees every job in the table and leaves it empty.
+ */
+void jobtable_free_jobs(jobtable_t *table)
+{
+	for(unsigned int i = 0; i < table->capacity; i++) {
+		free(table->slots[i]);
+		table->slots[i] = NULL;
+	}
+
+	table->count = 0;
+}
+
+
+/**
+  Frees the table, but not the jobs in it.
+ */
+void jobtable_destroy(jobtable_t *table)
+{
+	free(table->slots);
+	jobtable_init(table);
+}
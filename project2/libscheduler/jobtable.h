@@ -0,0 +1,26 @@
+/** @file jobtable.h
+ */
+
+#ifndef JOBTABLE_H_
+#define JOBTABLE_H_
+
+#include "job.h"
+
+/**
+  Hash table from job_id to the job_t of every job the scheduler holds,
+  waiting or running. Open addressing with linear probing over a
+  power-of-two table kept at most half full; slots are NULL when empty.
+*/
+typedef struct _jobtable_t {
+	job_t **slots;
+	unsigned int capacity, count;
+} jobtable_t;
+
+void   jobtable_init     (jobtable_t *table);
+int    jobtable_insert   (jobtable_t *table, job_t *job);
+job_t *jobtable_find     (const jobtable_t *table, int job_id);
+job_t *jobtable_remove   (jobtable_t *table, int job_id);
+void   jobtable_free_jobs(jobtable_t *table);
+void   jobtable_destroy  (jobtable_t *table);
+
+#endif /* JOBTABLE_H_ */
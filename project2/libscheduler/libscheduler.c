@@ -4,90 +4,183 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 
 #include "libscheduler.h"
-#include "../libpriqueue/libpriqueue.h"
+#include "job.h"
+#include "jobtable.h"
+#include "jobring.h"
 
-/**
-  Stores information making up a job to be scheduled including any statistics.
+typedef struct _core_t {
+  job_t* job;	//the job running on the core, or NULL when it is idle
+  int slice_start;	//when the job got the core, or was last charged for its time on it
+} core_t;
 
-  You may need to define some global variables or a struct to store your job queue elements. 
+/**
+  All the state of one scheduler. Nothing is shared between instances, so
+  each can run its own simulation on its own thread.
 */
+struct _scheduler_t {
+	core_t* core_list;
+	int num_cores;
+	unsigned long long* idle;	//bit i of word i/64 is set while core(id=i) is idle
+	int idle_words;
+	priqueue_t queue;	//jobs waiting for a core; running ones are in core_list
+	jobring_t ring;	//the waiting jobs instead, when fifo is set
+	int fifo;
+	priqueue_t* running;	//jobs on a core, under PPRI and PSJF only
+	jobtable_t jobs;	//every job not yet finished, by job_id
+	int(*job_compare)(const void *, const void *);
+	scheme_t scheme;
+	priqueue_backend_t queue_backend;
+	int queue_backend_chosen;
+
+	int priority_low;
+	int priority_high;
+
+	int num_jobs;
+	int next_seq;
+	int charged_at;	//last arrival that found every core busy under PPRI or PSJF
+
+	float waiting_time;
+	float turnaround_time;
+	float response_time;
+};
+
+//the instance behind the functions without a scheduler_t argument
+static scheduler_t default_scheduler = { .queue_backend = PRIQUEUE_TREE, .priority_high = -1 };
 
-typedef struct _job_t {
-  int job_id, core_id;
-  int arrival_time, run_time, priority;
-  int start_time, time_remaining, pause_time;
-  int responded;
-} job_t;
 
-typedef struct _core_t {
-  int active;
-} core_t;
+/**
+  Tells whether job a comes before job b in the queue order: by the
+  scheme's comparer, then by when each last joined the queue.
+*/
+static int job_before(scheduler_t *s, job_t *a, job_t *b)
+{
+	int diff = s->job_compare(a, b);
+
+	return diff != 0 ? diff < 0 : a->seq < b->seq;
+}
 
-core_t* core_list;
-priqueue_t* QUEUE;
-scheme_t CURRENT_SCHEME;
 
-int num_jobs;
-int num_cores;
+/**
+  Puts job on core core_id at time, or leaves the core idle if job is NULL,
+  keeping the idle bitmap in step.
+*/
+static void core_assign(scheduler_t *s, int core_id, job_t *job, int time)
+{
+	unsigned long long bit = 1ULL << (core_id % 64);
 
-float waiting_time;
-float turnaround_time;
-float response_time;
+	s->core_list[core_id].job = job;
+	s->core_list[core_id].slice_start = time;
 
+	if(job) {
+		job->end_time = time + job->time_remaining;
+		s->idle[core_id / 64] &= ~bit;
+	}
+	else {
+		s->idle[core_id / 64] |= bit;
+	}
+}
 
-/* COMPARISON FUNCTIONS */
 
-int FCFS_COMPARE(const void *a, const void *b) {
-	job_t* jobA = (job_t*) a;
-	job_t* jobB = (job_t*) b;
+/**
+  Returns the lowest-numbered idle core, or -1 if every core is busy.
+*/
+static int lowest_idle_core(scheduler_t *s)
+{
+	for(int w=0; w<s->idle_words; w++) {
+		if(s->idle[w])
+			return w * 64 + __builtin_ctzll(s->idle[w]);
+	}
 
-	return jobA->arrival_time - jobB->arrival_time;
+	return -1;
 }
 
-int SJF_COMPARE(const void *a, const void *b) {
-	job_t* jobA = (job_t*) a;
-	job_t* jobB = (job_t*) b;
 
-	int diff = jobA->run_time -jobB->run_time;
+/**
+  Queues a job that is waiting for a core.
 
-	if(diff == 0) {
-		diff = jobA->arrival_time - jobB->arrival_time;
-	}
+  @return 1 on success, 0 if memory ran out
+*/
+static int ready_offer(scheduler_t *s, job_t *job)
+{
+	if(s->fifo)
+		return jobring_push(&s->ring, job);
 
-	return diff;
+	return priqueue_offer_handle(&s->queue, job, &job->handle) >= 0;
 }
 
-int PSJF_COMPARE(const void *a, const void *b) {
-	job_t* jobA = (job_t*) a;
-	job_t* jobB = (job_t*) b;
 
-	int diff = jobA->time_remaining - jobB->time_remaining;
+/**
+  Takes the next job to run out of the waiting jobs, or returns NULL.
+*/
+static job_t *ready_poll(scheduler_t *s)
+{
+	if(s->fifo)
+		return jobring_pop(&s->ring);
+
+	return (job_t*) priqueue_poll(&s->queue);
+}
 
-	if(diff == 0) {
-		diff = jobA->arrival_time - jobB->arrival_time;
-	}
 
-	return diff;
+/**
+  Forgets a job that scheduler_new_job_r() recorded but could not queue,
+  and returns SCHEDULER_NO_MEMORY for it.
+*/
+static int drop_new_job(scheduler_t *s, job_t *job)
+{
+	jobtable_remove(&s->jobs, job->job_id);
+	s->num_jobs--;
+	free(job);
+
+	return SCHEDULER_NO_MEMORY;
 }
 
-int PRI_COMPARE(const void *a, const void *b) {
-	job_t* jobA = (job_t*) a;
-	job_t* jobB = (job_t*) b;
 
-	int diff = jobA->priority - jobB->priority;
+/**
+  Selects the priqueue backend the job queue is built on.
 
-	if(diff == 0) {
-		diff = jobA->arrival_time - jobB->arrival_time;
-	}
+  Without this call each scheme gets a queue suited to its comparer: a
+  bucket queue for FCFS, and for PRI and PPRI when the priority range
+  allows (see scheduler_set_priority_range()), a heap of cached 64-bit
+  keys for SJF and PSJF, and for RR no priqueue at all: every job ties,
+  so waiting jobs go in a ring buffer, O(1) each way.
+
+  Assumptions:
+    - If called at all, this is called before scheduler_start_up().
 
-	return diff;
+  @param s the scheduler
+  @param backend the storage backend for the job queue. Defaults to PRIQUEUE_TREE,
+  since the scheduler walks the queue by index. The tree is built
+  intrusively on each job's embedded node, so queueing a job allocates nothing.
+*/
+void scheduler_set_queue_backend_r(scheduler_t *s, priqueue_backend_t backend)
+{
+	s->queue_backend = backend;
+	s->queue_backend_chosen = 1;
 }
 
-//Not yet implemented
-int RR_COMPARE(const void *a, const void *b) {
-  return 1;
+
+/**
+  Tells the scheduler which job priorities to expect.
+
+  Unless a backend was chosen with scheduler_set_queue_backend(), PRI and
+  PPRI then queue jobs in a bucket queue with one bucket per priority, as
+  long as the range spans at most SCHEDULER_PRIORITY_BUCKETS values. FCFS
+  always uses a single bucket, since jobs arrive in order.
+
+  Assumptions:
+    - If called at all, this is called before scheduler_start_up().
+
+  @param s the scheduler
+  @param lowest the smallest priority any job will have
+  @param highest the largest priority any job will have
+*/
+void scheduler_set_priority_range_r(scheduler_t *s, int lowest, int highest)
+{
+	s->priority_low = lowest;
+	s->priority_high = highest;
 }
 
 
@@ -100,48 +193,75 @@ int RR_COMPARE(const void *a, const void *b) {
     - You may assume that cores is a positive, non-zero number.
     - You may assume that scheme is a valid scheduling scheme.
 
+  @param s the scheduler
   @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
   @param scheme  the scheduling scheme that should be used. This value will be one of the six enum values of scheme_t
 */
-void scheduler_start_up(int cores, scheme_t scheme)
+void scheduler_start_up_r(scheduler_t *s, int cores, scheme_t scheme)
 {
-	num_jobs = 0;
-
-	QUEUE = malloc(sizeof(priqueue_t));
-
-	num_cores = cores;
-	core_list = malloc(cores*sizeof(core_t));
+	s->num_jobs = 0;
+	s->next_seq = 0;
+	s->charged_at = 0;
+	s->waiting_time = s->turnaround_time = s->response_time = 0;
+	jobtable_init(&s->jobs);
+	jobring_init(&s->ring);
+
+	s->num_cores = cores;
+	s->core_list = malloc(cores*sizeof(core_t));
+	s->idle_words = (cores + 63) / 64;
+	s->idle = calloc(s->idle_words, sizeof(unsigned long long));
 
 	for(int i=0; i<cores; i++) {
-		core_list[i].active = -1;
+		core_assign(s, i, NULL, 0);
 	}
 
+	int(*comparer)(const void *, const void *) = NULL;
+
 	switch(scheme) {
 		case FCFS:
-			CURRENT_SCHEME = FCFS;
-			priqueue_init(QUEUE, FCFS_COMPARE);
+			comparer = FCFS_COMPARE;
 		break;
 		case SJF:
-			CURRENT_SCHEME = SJF;
-			priqueue_init(QUEUE, SJF_COMPARE);
+			comparer = SJF_COMPARE;
 		break;
 		case PSJF:
-			CURRENT_SCHEME = PSJF;
-			priqueue_init(QUEUE, PSJF_COMPARE);
+			comparer = PSJF_COMPARE;
 		break;
 		case PPRI:
-			CURRENT_SCHEME = PPRI;
-			priqueue_init(QUEUE, PRI_COMPARE);
-		break;
 		case PRI:
-			CURRENT_SCHEME = PRI;
-			priqueue_init(QUEUE, PRI_COMPARE);
+			comparer = PRI_COMPARE;
 		break;
 		case RR:
-			CURRENT_SCHEME = RR;
-			priqueue_init(QUEUE, RR_COMPARE);
+			comparer = RR_COMPARE;
 		break;
 	}
+
+	s->scheme = scheme;
+	s->job_compare = comparer;
+	s->fifo = !s->queue_backend_chosen && scheme == RR;
+
+	//the preemptive schemes look for the worst running job on every arrival;
+	//under PSJF it is kept by finish time, which stays put as the jobs run
+	s->running = NULL;
+	if(scheme == PPRI || scheme == PSJF) {
+		s->running = malloc(sizeof(priqueue_t));
+		priqueue_init_backend(s->running, scheme == PSJF ? PSJF_END_COMPARE : comparer, PRIQUEUE_MINMAX);
+	}
+
+	int priorities = s->priority_high - s->priority_low + 1;
+
+	if(!s->queue_backend_chosen && scheme == FCFS)
+		priqueue_init_bucket(&s->queue, comparer, FCFS_KEY, 0, 0);
+	else if(!s->queue_backend_chosen && (scheme == PRI || scheme == PPRI) && priorities > 0 && priorities <= SCHEDULER_PRIORITY_BUCKETS)
+		priqueue_init_bucket(&s->queue, comparer, PRI_KEY, s->priority_low, s->priority_high);
+	else if(!s->queue_backend_chosen && scheme == SJF)
+		priqueue_init_keyed(&s->queue, SJF_KEY64);
+	else if(!s->queue_backend_chosen && scheme == PSJF)
+		priqueue_init_keyed(&s->queue, PSJF_KEY64);
+	else if(s->queue_backend == PRIQUEUE_TREE)
+		priqueue_init_intrusive(&s->queue, comparer, offsetof(job_t, node));
+	else
+		priqueue_init_backend(&s->queue, comparer, s->queue_backend);
 }
 
 
@@ -157,19 +277,24 @@ void scheduler_start_up(int cores, scheme_t scheme)
   Assumptions:
     - You may assume that every job wil have a unique arrival time.
 
+  @param s the scheduler
   @param job_number a globally unique identification number of the job arriving.
   @param time the current time of the simulator.
   @param running_time the total number of time units this job will run before it will be finished.
   @param priority the priority of the job. (The lower the value, the higher the priority.)
   @return index of core job should be scheduled on
   @return -1 if no scheduling changes should be made. 
+  @return SCHEDULER_NO_MEMORY if the job could not be recorded or queued; the scheduler is unchanged.
  
  */
-int scheduler_new_job(int job_number, int time, int running_time, int priority)
+int scheduler_new_job_r(scheduler_t *s, int job_number, int time, int running_time, int priority)
 {
 	//So, Let's declare a new job that we will add to the queue
 	job_t *new_job = malloc(sizeof(job_t));
 
+	if(new_job == NULL)
+		return SCHEDULER_NO_MEMORY;
+
 	new_job->job_id 		= job_number;
 	new_job->core_id		= -1;
 	new_job->arrival_time 	= time;
@@ -177,58 +302,73 @@ int scheduler_new_job(int job_number, int time, int running_time, int priority)
 	new_job->run_time 		= running_time;
 	new_job->time_remaining = running_time;
 	new_job->pause_time		= time;
-	new_job->start_time 	= -1;
 	new_job->responded  	= -1;
+	new_job->seq			= s->next_seq++;
+	pq_node_init(&new_job->node);
 
-	num_jobs++;
+	//job_finished finds the job through the table, so it must go in
+	if(!jobtable_insert(&s->jobs, new_job)) {
+		free(new_job);
+		return SCHEDULER_NO_MEMORY;
+	}
 
-	//Check each core, looking for one that is inactive
-	int core_index = -1;
+	s->num_jobs++;
 
-	for(int i=0; i<num_cores; i++) {
-		if(core_list[i].active == -1) {
-			core_index = i;
-			break;
-		}
-	}
+	int core_index = lowest_idle_core(s);
 
 	if(core_index != -1) {
-		priqueue_offer(QUEUE, new_job);
-
 		new_job->core_id = core_index;
 		new_job->responded = 1;
-		new_job->start_time = time;
+		core_assign(s, core_index, new_job, time);
 
-		core_list[core_index].active = 1;
+		if(s->running && priqueue_offer_handle(s->running, new_job, &new_job->run_handle) < 0) {
+			core_assign(s, core_index, NULL, time);
+			return drop_new_job(s, new_job);
+		}
 	}
-	else if(CURRENT_SCHEME == PPRI || CURRENT_SCHEME == PSJF) {
+	else if(s->scheme == PPRI || s->scheme == PSJF) {
 
-		job_t* temp = NULL;
+		//every core is busy; the new job preempts exactly when it beats the worst running job
+		job_t* temp = (job_t*) priqueue_peek_max(s->running);
+		core_t* core = &s->core_list[temp->core_id];
 
-		for(int i=0; i<num_cores; i++) {
-			temp = (job_t*) priqueue_at(QUEUE, i);
-			temp->time_remaining = temp->time_remaining - (time - temp->start_time);
-			temp->start_time = time;
-		}
+		//charge only that job for the time it ran, so PSJF compares what it has left
+		temp->time_remaining = temp->time_remaining - (time - core->slice_start);
+		core->slice_start = time;
+		s->charged_at = time;
 
-		priqueue_offer(QUEUE, new_job);
+		if(s->job_compare(new_job, temp) < 0) {
 
-		for(int i=0; i<num_cores; i++) {
-			if((job_t*) priqueue_at(QUEUE, i) == new_job) {
-				core_index = temp->core_id;
+			//both jobs are queued before anything moves, so running out of memory moves nothing
+			new_job->end_time = time + new_job->time_remaining;
 
-				new_job->core_id = core_index;
-				new_job->start_time = time;
-				new_job->pause_time = 0;
-				new_job->responded = 1;
+			if(!ready_offer(s, temp))
+				return drop_new_job(s, new_job);
 
-				temp->core_id = -1;
-				temp->pause_time = time;
+			if(priqueue_offer_handle(s->running, new_job, &new_job->run_handle) < 0) {
+				priqueue_remove_handle(&s->queue, temp->handle);
+				return drop_new_job(s, new_job);
 			}
+
+			priqueue_remove_handle(s->running, temp->run_handle);
+
+			core_index = temp->core_id;
+
+			new_job->core_id = core_index;
+			new_job->pause_time = 0;
+			new_job->responded = 1;
+
+			temp->core_id = -1;
+			temp->pause_time = time;
+
+			core_assign(s, core_index, new_job, time);
+		}
+		else if(!ready_offer(s, new_job)) {
+			return drop_new_job(s, new_job);
 		}
 	}
-	else {
-		priqueue_offer(QUEUE, new_job);
+	else if(!ready_offer(s, new_job)) {
+		return drop_new_job(s, new_job);
 	}
 
 	return core_index;
@@ -243,64 +383,45 @@ int scheduler_new_job(int job_number, int time, int running_time, int priority)
   finished job, return the job_number of the job that should be scheduled to
   run on core core_id.
  
+  @param s the scheduler
   @param core_id the zero-based index of the core where the job was located.
   @param job_number a globally unique identification number of the job.
   @param time the current time of the simulator.
   @return job_number of the job that should be scheduled to run on core core_id
   @return -1 if core should remain idle.
  */
-int scheduler_job_finished(int core_id, int job_number, int time)
+int scheduler_job_finished_r(scheduler_t *s, int core_id, int job_number, int time)
 {
 	int wake_job_id = -1;
 
-	int i = 0;
-	job_t* finished = NULL;
-	job_t* wake_job = NULL;
-	job_t* temp = NULL;
-
-	while(i<priqueue_size(QUEUE) && !finished) {
-		temp = (job_t*) priqueue_at(QUEUE, i);
-
-		if(temp->job_id == job_number) {
-			finished = (job_t*) priqueue_remove_at(QUEUE, i);
-			temp = NULL;
-		}
+	job_t* finished = jobtable_remove(&s->jobs, job_number);
+	job_t* wake_job = ready_poll(s);
 
-		i++;
-	}
+	s->turnaround_time += (time - finished->arrival_time);
 
-	turnaround_time += (time - finished->arrival_time);
+	if(s->running)
+		priqueue_remove_handle(s->running, finished->run_handle);
 
 	free(finished);
-
-	i = 0;
-	while(i<priqueue_size(QUEUE) && !wake_job) {
-		temp = (job_t*) priqueue_at(QUEUE, i);
-		if(temp->core_id == -1) {
-			wake_job = (job_t*) priqueue_at(QUEUE, i);
-			temp = NULL;
-		}
-
-		i++;
-	}
+	core_assign(s, core_id, wake_job, time);
 
 	if(wake_job) {
 		wake_job_id = wake_job->job_id;
 
-		waiting_time += time - wake_job->pause_time;
+		s->waiting_time += time - wake_job->pause_time;
 
 		wake_job->core_id	 = core_id;
-		wake_job->start_time = time;
 		wake_job->pause_time = 0;
 
+		//this takes the node the finished job just gave back, so it can not run out of memory
+		if(s->running)
+			priqueue_offer_handle(s->running, wake_job, &wake_job->run_handle);
+
 		if(wake_job->responded == -1) {
 			wake_job->responded = 1;
-			response_time += time - wake_job->arrival_time;
+			s->response_time += time - wake_job->arrival_time;
 		}
 	}
-	else {
-		core_list[core_id].active = -1;
-	}
 
 	return wake_job_id;
 }
@@ -314,67 +435,50 @@ int scheduler_job_finished(int core_id, int job_number, int time)
   the quantum expiration, return the job_number of the job that should be
   scheduled to run on core core_id.
 
+  @param s the scheduler
   @param core_id the zero-based index of the core where the quantum has expired.
   @param time the current time of the simulator. 
   @return job_number of the job that should be scheduled on core cord_id
   @return -1 if core should remain idle
+  @return SCHEDULER_NO_MEMORY if the expired job could not be queued; the scheduler is unchanged.
  */
-int scheduler_quantum_expired(int core_id, int time)
+int scheduler_quantum_expired_r(scheduler_t *s, int core_id, int time)
 {
 	int wake_job_id = -1;
-	job_t* expire_job = NULL;
+	job_t* expire_job = s->core_list[core_id].job;
 	job_t* wake_job = NULL;
-	job_t* temp = NULL;
-
-	int i = 0;
-	while(i<priqueue_size(QUEUE) && !expire_job) {
-		temp = (job_t*) priqueue_at(QUEUE, i);
-		if(temp->core_id == core_id) {
-			expire_job = (job_t*) priqueue_remove_at(QUEUE, i);
-			temp = NULL;
-		}
-
-		i++;
-	}
 
 	if(expire_job) {
-		expire_job->core_id = -1;
-		expire_job->pause_time = time;
-		expire_job->time_remaining = expire_job->time_remaining - (time - expire_job->start_time);
+		int seq = expire_job->seq;
 
-		priqueue_offer(QUEUE, expire_job);
-
-		i = 0;
-		while(i<priqueue_size(QUEUE) && !wake_job) {
-			temp = (job_t*) priqueue_at(QUEUE, i);
-			if(temp->core_id == -1) {
-				wake_job = (job_t*) priqueue_at(QUEUE, i);
-				temp = NULL;
-			}
+		//equal under RR, so it goes in behind every job that was already waiting;
+		//with nobody else waiting, the expired job comes straight back out and runs again
+		expire_job->seq = s->next_seq++;
 
-			i++;
+		if(!ready_offer(s, expire_job)) {
+			expire_job->seq = seq;
+			s->next_seq--;
+			return SCHEDULER_NO_MEMORY;
 		}
 
-		if(wake_job) {
-			wake_job_id = wake_job->job_id;
+		expire_job->core_id = -1;
+		expire_job->pause_time = time;
+		expire_job->time_remaining = expire_job->time_remaining - (time - s->core_list[core_id].slice_start);
 
-			waiting_time += time - wake_job->pause_time;
+		wake_job = ready_poll(s);
+		wake_job_id = wake_job->job_id;
 
-			wake_job->core_id = core_id;
-			wake_job->start_time = time;
-			wake_job->pause_time = -1;
+		s->waiting_time += time - wake_job->pause_time;
 
-			if(wake_job->responded == -1) {
-				wake_job->responded = 1;
-				response_time += time - wake_job->arrival_time;
-			}
-		}
-		else {
-			core_list[core_id].active = -1;
+		wake_job->core_id = core_id;
+		wake_job->pause_time = -1;
+
+		if(wake_job->responded == -1) {
+			wake_job->responded = 1;
+			s->response_time += time - wake_job->arrival_time;
 		}
-	}
-	else {
-		core_list[core_id].active = -1;
+
+		core_assign(s, core_id, wake_job, time);
 	}
 
 	return wake_job_id;
@@ -386,11 +490,12 @@ int scheduler_quantum_expired(int core_id, int time)
 
   Assumptions:
     - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
   @return the average waiting time of all jobs scheduled.
  */
-float scheduler_average_waiting_time()
+float scheduler_average_waiting_time_r(scheduler_t *s)
 {
-  return( (float)(waiting_time)/num_jobs );
+  return( (float)(s->waiting_time)/s->num_jobs );
 }
 
 
@@ -399,11 +504,12 @@ float scheduler_average_waiting_time()
 
   Assumptions:
     - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
   @return the average turnaround time of all jobs scheduled.
  */
-float scheduler_average_turnaround_time()
+float scheduler_average_turnaround_time_r(scheduler_t *s)
 {
-	return ( (float)(turnaround_time)/num_jobs );
+	return ( (float)(s->turnaround_time)/s->num_jobs );
 }
 
 
@@ -412,11 +518,50 @@ float scheduler_average_turnaround_time()
 
   Assumptions:
     - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
   @return the average response time of all jobs scheduled.
  */
-float scheduler_average_response_time()
+float scheduler_average_response_time_r(scheduler_t *s)
+{
+	return ( (float)(s->response_time)/s->num_jobs );
+}
+
+
+/**
+  Returns how many cores have no job, from the idle bitmap, so the
+  utilization is 1 - idle/cores at any point of the simulation.
+
+  Assumptions:
+    - This function will only be called after scheduler_start_up() and before scheduler_clean_up().
+  @param s the scheduler
+  @return the number of idle cores
+ */
+int scheduler_idle_cores_r(scheduler_t *s)
+{
+	int idle = 0;
+
+	for(int w=0; w<s->idle_words; w++) {
+		idle += __builtin_popcountll(s->idle[w]);
+	}
+
+	return idle;
+}
+
+
+/**
+  Copies out the operation counters (see priqueue_stats()) of the queue
+  the waiting jobs are actually kept in: the ring buffer under RR when no
+  backend was chosen, the priqueue otherwise.
+
+  Assumptions:
+    - This function will only be called before scheduler_clean_up().
+  @param s the scheduler
+  @param stats set to the counters, or zeroed if the library was built without them
+  @return 1 if the counters are kept, 0 if not
+ */
+int scheduler_queue_stats_r(scheduler_t *s, priqueue_stats_t *stats)
 {
-	return ( (float)(response_time)/num_jobs );
+	return s->fifo ? jobring_stats(&s->ring, stats) : priqueue_stats(&s->queue, stats);
 }
 
 
@@ -425,11 +570,23 @@ float scheduler_average_response_time()
  
   Assumptions:
     - This function will be the last function called in your library.
+  @param s the scheduler
 */
-void scheduler_clean_up()
+void scheduler_clean_up_r(scheduler_t *s)
 {
-	priqueue_destroy(QUEUE);
-	free(core_list);
+	//jobs still waiting or running if the simulation stopped early
+	jobtable_free_jobs(&s->jobs);
+	jobtable_destroy(&s->jobs);
+	jobring_destroy(&s->ring);
+
+	priqueue_destroy(&s->queue);
+	free(s->core_list);
+	free(s->idle);
+
+	if(s->running) {
+		priqueue_destroy(s->running);
+		free(s->running);
+	}
 }
 
 
@@ -443,13 +600,149 @@ void scheduler_clean_up()
   
   This function is not required and will not be graded. You may leave it
   blank if you do not find it useful.
+  @param s the scheduler
  */
-void scheduler_show_queue()
+void scheduler_show_queue_r(scheduler_t *s)
 {
 	job_t *job;
+	job_t running[s->num_cores];
+	priqueue_iter_t it;
+	unsigned int waiting = 0;
+	int n = 0;
+
+	//copies of the running jobs, charged up to the last arrival that found
+	//every core busy, sorted into the places they would hold in the queue
+	for(int i=0; i<s->num_cores; i++) {
+		if(s->core_list[i].job == NULL)
+			continue;
+
+		job_t shown = *s->core_list[i].job;
+
+		if(s->charged_at > s->core_list[i].slice_start)
+			shown.time_remaining -= s->charged_at - s->core_list[i].slice_start;
+
+		int j = n++;
+		while(j > 0 && job_before(s, &shown, &running[j-1])) {
+			running[j] = running[j-1];
+			j--;
+		}
+		running[j] = shown;
+	}
 
-	for(int i=0; i<priqueue_size(QUEUE); i++) {
-		job = (job_t*) priqueue_at(QUEUE, i);
-		printf("%d(%d)[%d] ", job->job_id, job->core_id, job->time_remaining);
+	job = s->fifo ? jobring_at(&s->ring, waiting++) : priqueue_iter_begin(&s->queue, &it);
+	for(int i=0; i<n || job != NULL; ) {
+		if(i < n && (job == NULL || job_before(s, &running[i], job))) {
+			printf("%d(%d)[%d] ", running[i].job_id, running[i].core_id, running[i].time_remaining);
+			i++;
+		}
+		else {
+			printf("%d(%d)[%d] ", job->job_id, job->core_id, job->time_remaining);
+			job = s->fifo ? jobring_at(&s->ring, waiting++) : priqueue_iter_next(&it);
+		}
 	}
+
+	if(!s->fifo)
+		priqueue_iter_end(&it);
+}
+
+
+/**
+  Creates a scheduler with the default settings, to be configured with
+  scheduler_set_queue_backend_r() and scheduler_set_priority_range_r() if
+  need be and then started with scheduler_start_up_r().
+
+  @return the new scheduler, or NULL if memory ran out
+*/
+scheduler_t* scheduler_create()
+{
+	scheduler_t* s = calloc(1, sizeof(scheduler_t));
+
+	if(s == NULL)
+		return NULL;
+
+	s->queue_backend = PRIQUEUE_TREE;
+	s->priority_high = -1;
+
+	return s;
+}
+
+
+/**
+  Frees a scheduler from scheduler_create(), which must have been cleaned
+  up with scheduler_clean_up_r() if it was started.
+*/
+void scheduler_destroy(scheduler_t* s)
+{
+	free(s);
+}
+
+
+/*
+  The original interface, on the default scheduler. Each function is the
+  _r one of the same name, documented above.
+*/
+
+void scheduler_set_queue_backend(priqueue_backend_t backend)
+{
+	scheduler_set_queue_backend_r(&default_scheduler, backend);
+}
+
+void scheduler_set_priority_range(int lowest, int highest)
+{
+	scheduler_set_priority_range_r(&default_scheduler, lowest, highest);
+}
+
+void scheduler_start_up(int cores, scheme_t scheme)
+{
+	scheduler_start_up_r(&default_scheduler, cores, scheme);
+}
+
+int scheduler_new_job(int job_number, int time, int running_time, int priority)
+{
+	return scheduler_new_job_r(&default_scheduler, job_number, time, running_time, priority);
+}
+
+int scheduler_job_finished(int core_id, int job_number, int time)
+{
+	return scheduler_job_finished_r(&default_scheduler, core_id, job_number, time);
+}
+
+int scheduler_quantum_expired(int core_id, int time)
+{
+	return scheduler_quantum_expired_r(&default_scheduler, core_id, time);
+}
+
+float scheduler_average_waiting_time()
+{
+	return scheduler_average_waiting_time_r(&default_scheduler);
+}
+
+float scheduler_average_turnaround_time()
+{
+	return scheduler_average_turnaround_time_r(&default_scheduler);
+}
+
+float scheduler_average_response_time()
+{
+	return scheduler_average_response_time_r(&default_scheduler);
+}
+
+int scheduler_idle_cores()
+{
+	return scheduler_idle_cores_r(&default_scheduler);
+}
+
+int scheduler_queue_stats(priqueue_stats_t *stats)
+{
+	return scheduler_queue_stats_r(&default_scheduler, stats);
+}
+
+void scheduler_clean_up()
+{
+	scheduler_clean_up_r(&default_scheduler);
+}
+
+void scheduler_show_queue()
+{
+	scheduler_show_queue_r(&default_scheduler);
 }
@@ -4,11 +4,48 @@
 #ifndef LIBSCHEDULER_H_
 #define LIBSCHEDULER_H_
 
+#include "../libpriqueue/libpriqueue.h"
+
 /**
   Constants which represent the different scheduling algorithms
 */
 typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR} scheme_t;
 
+/**
+  Widest priority range that still gets one queue bucket per priority
+*/
+#define SCHEDULER_PRIORITY_BUCKETS 1024
+
+/**
+  Returned by scheduler_new_job() when it runs out of memory
+*/
+#define SCHEDULER_NO_MEMORY -2
+
+/**
+  A scheduler instance, from scheduler_create(). The functions ending in
+  _r work on the instance they are given; the ones without a scheduler_t
+  argument work on a single default instance.
+*/
+typedef struct _scheduler_t scheduler_t;
+
+scheduler_t *scheduler_create        ();
+void  scheduler_set_queue_backend_r    (scheduler_t *s, priqueue_backend_t backend);
+void  scheduler_set_priority_range_r   (scheduler_t *s, int lowest, int highest);
+void  scheduler_start_up_r             (scheduler_t *s, int cores, scheme_t scheme);
+int   scheduler_new_job_r              (scheduler_t *s, int job_number, int time, int running_time, int priority);
+int   scheduler_job_finished_r         (scheduler_t *s, int core_id, int job_number, int time);
+int   scheduler_quantum_expired_r      (scheduler_t *s, int core_id, int time);
+float scheduler_average_turnaround_time_r(scheduler_t *s);
+float scheduler_average_waiting_time_r (scheduler_t *s);
+float scheduler_average_response_time_r(scheduler_t *s);
+int   scheduler_idle_cores_r           (scheduler_t *s);
+int   scheduler_queue_stats_r          (scheduler_t *s, priqueue_stats_t *stats);
+void  scheduler_clean_up_r             (scheduler_t *s);
+void  scheduler_show_queue_r           (scheduler_t *s);
+void  scheduler_destroy                (scheduler_t *s);
+
+void  scheduler_set_queue_backend      (priqueue_backend_t backend);
+void  scheduler_set_priority_range     (int lowest, int highest);
 void  scheduler_start_up               (int cores, scheme_t scheme);
 int   scheduler_new_job                (int job_number, int time, int running_time, int priority);
 int   scheduler_job_finished           (int core_id, int job_number, int time);
@@ -16,6 +53,8 @@ int   scheduler_quantum_expired        (int core_id, int time);
 float scheduler_average_turnaround_time();
 float scheduler_average_waiting_time   ();
 float scheduler_average_response_time  ();
+int   scheduler_idle_cores             ();
+int   scheduler_queue_stats            (priqueue_stats_t *stats);
 void  scheduler_clean_up               ();
 
 void  scheduler_show_queue             ();
@@ -0,0 +1,309 @@
+/** @file priqueue_bench.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "libpriqueue/libpriqueue.h"
+#include "libpriqueue/pqtree.h"
+
+/*
+ * Throughput and latency of every priqueue backend, as CSV on stdout.
+ *
+ * For each backend, key pattern and size (10, 100, ... up to the maximum)
+ * one run offers n elements, looks up elements at random indexes with
+ * priqueue_at, removes random elements with priqueue_remove, and polls the
+ * rest. Each phase reports its operations per second, measured over the
+ * whole phase, and the median and 99th percentile of single operations,
+ * timed on at most MAX_SAMPLES evenly spaced ones.
+ *
+ * Key patterns: random, sorted (ascending, the order the queue polls in),
+ * reverse, and dups (only DUP_KEYS distinct keys).
+ *
+ * The at and remove phases stop after PROBE_OPS operations or PROBE_TIME
+ * seconds, since on some backends one priqueue_at is O(n). A backend stops
+ * growing for a pattern once its next run is predicted to take over BUDGET
+ * seconds, going by how much the last size step cost its offer and poll
+ * phases; the skipped sizes are noted on stderr. A quadratic backend
+ * shows up as ops_per_sec falling tenfold per size, and as the sizes it
+ * gives up on.
+ *
+ * Usage: priqueue_bench [max elements]   (default 10000000)
+ */
+
+#define MAX_SAMPLES 100000
+#define PROBE_OPS   1000
+#define PROBE_TIME  0.5
+#define BUDGET      30.0
+#define DUP_KEYS    8
+#define BUCKET_KEYS 4096
+
+enum { RANDOM, SORTED, REVERSE, DUPS, NUM_PATTERNS };
+
+const char *pattern_names[NUM_PATTERNS] = { "random", "sorted", "reverse", "dups" };
+
+/* intrusive queues link the node in the element itself */
+typedef struct _item_t
+{
+	int key;
+	struct pq_node node;
+} item_t;
+
+typedef struct _bench_backend_t
+{
+	const char *name;
+	void (*init)(priqueue_t *q);
+} bench_backend_t;
+
+typedef struct _phase_t
+{
+	int ops;
+	double elapsed;
+	float *samples;
+	int num_samples;
+} phase_t;
+
+int compare(const void *a, const void *b)
+{
+	return ((const item_t *)a)->key - ((const item_t *)b)->key;
+}
+
+int item_key(const void *a)
+{
+	return ((const item_t *)a)->key;
+}
+
+unsigned long long item_key64(const void *a)
+{
+	return (unsigned long long)((const item_t *)a)->key;
+}
+
+void init_list(priqueue_t *q) { priqueue_init_backend(q, compare, PRIQUEUE_LIST); }
+void init_heap(priqueue_t *q) { priqueue_init_backend(q, compare, PRIQUEUE_HEAP); }
+void init_tree(priqueue_t *q) { priqueue_init_backend(q, compare, PRIQUEUE_TREE); }
+void init_minmax(priqueue_t *q) { priqueue_init_backend(q, compare, PRIQUEUE_MINMAX); }
+void init_dary(priqueue_t *q) { priqueue_init_backend(q, compare, PRIQUEUE_DARY); }
+void init_pairing(priqueue_t *q) { priqueue_init_backend(q, compare, PRIQUEUE_PAIRING); }
+void init_intrusive(priqueue_t *q) { priqueue_init_intrusive(q, compare, offsetof(item_t, node)); }
+void init_bucket(priqueue_t *q) { priqueue_init_bucket(q, compare, item_key, 0, BUCKET_KEYS - 1); }
+void init_radix(priqueue_t *q) { priqueue_init_radix(q, item_key64); }
+void init_keyed(priqueue_t *q) { priqueue_init_keyed(q, item_key64); }
+void init_persistent(priqueue_t *q) { priqueue_init_persistent(q, compare); }
+void init_concurrent(priqueue_t *q) { priqueue_concurrent_init(q, compare); }
+void init_relaxed(priqueue_t *q) { priqueue_concurrent_init_flags(q, compare, PRIQUEUE_RELAXED); }
+
+/* the interchangeable backends first, in priqueue_backend_t order */
+bench_backend_t bench_backends[] =
+{
+	{ "list", init_list },
+	{ "heap", init_heap },
+	{ "tree", init_tree },
+	{ "minmax", init_minmax },
+	{ "dary", init_dary },
+	{ "pairing", init_pairing },
+	{ "intrusive", init_intrusive },
+	{ "bucket", init_bucket },
+	{ "radix", init_radix },
+	{ "keyed", init_keyed },
+	{ "persistent", init_persistent },
+	{ "concurrent", init_concurrent },
+	{ "relaxed", init_relaxed }
+};
+
+#define NUM_BENCH_BACKENDS ((int)(sizeof(bench_backends) / sizeof(bench_backends[0])))
+
+double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void fill_keys(item_t *items, int n, int pattern)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		switch (pattern)
+		{
+			case RANDOM:  items[i].key = rand() % (10 * n); break;
+			case SORTED:  items[i].key = i; break;
+			case REVERSE: items[i].key = n - i; break;
+			case DUPS:    items[i].key = rand() % DUP_KEYS; break;
+		}
+	}
+}
+
+/* Starts a phase of up to max_ops operations; one in every stride is timed. */
+void phase_begin(phase_t *p, int max_ops, int *stride)
+{
+	*stride = (max_ops + MAX_SAMPLES - 1) / MAX_SAMPLES;
+	if (*stride < 1)
+		*stride = 1;
+
+	p->ops = 0;
+	p->num_samples = 0;
+	p->elapsed = now();
+}
+
+void phase_end(phase_t *p)
+{
+	p->elapsed = now() - p->elapsed;
+}
+
+int compare_float(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+
+	return (x > y) - (x < y);
+}
+
+void phase_print(phase_t *p, const char *backend, const char *pattern, int n, const char *op)
+{
+	double rate = p->elapsed > 0 ? p->ops / p->elapsed : 0;
+	float p50 = 0, p99 = 0;
+
+	if (p->num_samples > 0)
+	{
+		qsort(p->samples, p->num_samples, sizeof(float), compare_float);
+		p50 = p->samples[p->num_samples / 2];
+		p99 = p->samples[(int)(p->num_samples * 0.99)];
+	}
+
+	printf("%s,%s,%d,%s,%d,%.0f,%.0f,%.0f\n", backend, pattern, n, op, p->ops, rate, p50, p99);
+}
+
+/* One run; returns the seconds its offer and poll phases took, which
+   unlike the probes grow with n. */
+double run(bench_backend_t *backend, int pattern, int n, item_t *items, float *samples)
+{
+	priqueue_t q;
+	phase_t phase;
+	double t, full;
+	int i, stride, remaining;
+
+	srand(2016);
+	fill_keys(items, n, pattern);
+	backend->init(&q);
+	phase.samples = samples;
+
+	/* offer */
+	phase_begin(&phase, n, &stride);
+	for (i = 0; i < n; i++)
+	{
+		if (i % stride == 0)
+		{
+			t = now();
+			priqueue_offer(&q, &items[i]);
+			phase.samples[phase.num_samples++] = (now() - t) * 1e9;
+		}
+		else
+			priqueue_offer(&q, &items[i]);
+	}
+	phase.ops = n;
+	phase_end(&phase);
+	phase_print(&phase, backend->name, pattern_names[pattern], n, "offer");
+	full = phase.elapsed;
+
+	/* at, at random indexes */
+	phase_begin(&phase, PROBE_OPS, &stride);
+	while (phase.ops < PROBE_OPS && phase.ops < n && now() - phase.elapsed < PROBE_TIME)
+	{
+		int index = rand() % n;
+
+		t = now();
+		priqueue_at(&q, index);
+		phase.samples[phase.num_samples++] = (now() - t) * 1e9;
+		phase.ops++;
+	}
+	phase_end(&phase);
+	phase_print(&phase, backend->name, pattern_names[pattern], n, "at");
+
+	/* remove, of random elements still queued; removed ones get key -1 */
+	phase_begin(&phase, PROBE_OPS, &stride);
+	while (phase.ops < PROBE_OPS && phase.ops < n / 2 && now() - phase.elapsed < PROBE_TIME)
+	{
+		int index = rand() % n;
+
+		if (items[index].key == -1)
+			continue;
+
+		t = now();
+		priqueue_remove(&q, &items[index]);
+		phase.samples[phase.num_samples++] = (now() - t) * 1e9;
+		phase.ops++;
+
+		items[index].key = -1;
+	}
+	phase_end(&phase);
+	phase_print(&phase, backend->name, pattern_names[pattern], n, "remove");
+	remaining = n - phase.ops;
+
+	/* poll the rest */
+	phase_begin(&phase, remaining, &stride);
+	for (i = 0; i < remaining; i++)
+	{
+		if (i % stride == 0)
+		{
+			t = now();
+			priqueue_poll(&q);
+			phase.samples[phase.num_samples++] = (now() - t) * 1e9;
+		}
+		else
+			priqueue_poll(&q);
+	}
+	phase.ops = remaining;
+	phase_end(&phase);
+	phase_print(&phase, backend->name, pattern_names[pattern], n, "poll");
+	full += phase.elapsed;
+
+	priqueue_destroy(&q);
+
+	return full;
+}
+
+int main(int argc, char **argv)
+{
+	int max = argc > 1 ? atoi(argv[1]) : 10000000;
+	item_t *items = malloc(max * sizeof(item_t));
+	float *samples = malloc(MAX_SAMPLES * sizeof(float));
+	int b, pattern, n;
+
+	printf("backend,pattern,elements,operation,ops,ops_per_sec,p50_ns,p99_ns\n");
+
+	for (b = 0; b < NUM_BENCH_BACKENDS; b++)
+	{
+		for (pattern = 0; pattern < NUM_PATTERNS; pattern++)
+		{
+			double last = 0, growth = 10;
+
+			for (n = 10; n <= max; n *= 10)
+			{
+				double elapsed;
+
+				if (last * growth + 2 * PROBE_TIME > BUDGET)
+				{
+					fprintf(stderr, "%s %s: skipping %d elements and up, predicted over %.0f s\n",
+					        bench_backends[b].name, pattern_names[pattern], n, BUDGET);
+					break;
+				}
+
+				elapsed = run(&bench_backends[b], pattern, n, items, samples);
+				fflush(stdout);
+
+				//small runs are mostly overhead, so assume at least linear growth
+				growth = last > 0 && elapsed / last > 10 ? elapsed / last : 10;
+				last = elapsed;
+			}
+		}
+	}
+
+	free(items);
+	free(samples);
+
+	return 0;
+}
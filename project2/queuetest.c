@@ -3,8 +3,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <pthread.h>
 
 #include "libpriqueue/libpriqueue.h"
+#include "libpriqueue/pqtree.h"
 
 int compare1(const void * a, const void * b)
 {
@@ -16,12 +19,24 @@ int compare2(const void * a, const void * b)
 	return ( *(int*)b - *(int*)a );
 }
 
-int main()
+int int_key(const void * a)
+{
+	return *(int*)a;
+}
+
+unsigned long long int_key64(const void * a)
+{
+	return (unsigned int)*(int*)a ^ 0x80000000u;
+}
+
+void run_tests(priqueue_backend_t backend)
 {
 	priqueue_t q, q2;
 
-	priqueue_init(&q, compare1);
-	priqueue_init(&q2, compare2);
+	printf("== Backend: %s ==\n", priqueue_backend_name(backend));
+
+	priqueue_init_backend(&q, compare1, backend);
+	priqueue_init_backend(&q2, compare2, backend);
 
 	/* Pupulate some data... */
 	int *values = malloc(100 * sizeof(int));
@@ -65,10 +80,884 @@ int main()
 		printf("%d ", *((int *)priqueue_at(&q2, i)) );
 	printf("\n");
 
+	int live, slabs;
+	priqueue_pool_usage(&q, &live, &slabs);
+	printf("Live pool nodes: %d (expected %d).\n", live, priqueue_size(&q));
+
 	priqueue_destroy(&q2);
 	priqueue_destroy(&q);
 
 	free(values);
+}
+
+/* Replays one random operation sequence on q, which must be empty and ordered
+   by compare1, and on the list backend and checks that both return the same
+   elements in the same order. Destroys q. */
+int cross_check_queue(priqueue_t *q, int ops)
+{
+	priqueue_t ref;
+	int *values = malloc(ops * sizeof(int));
+	priqueue_handle_t *ref_handles = malloc(ops * sizeof(priqueue_handle_t));
+	priqueue_handle_t *handles = malloc(ops * sizeof(priqueue_handle_t));
+	int i, n = 0, failures = 0;
+
+	priqueue_init(&ref, compare1);
+	srand(678);
+
+	for (i = 0; i < ops; i++)
+	{
+		int op = rand() % 10;
+		void *a = NULL, *b = NULL;
+
+		if (op < 5 || n == 0)
+		{
+			values[i] = rand() % 50;
+			priqueue_offer_handle(&ref, &values[i], &ref_handles[i]);
+			priqueue_offer_handle(q, &values[i], &handles[i]);
+			n++;
+		}
+		else if (op < 7)
+		{
+			a = priqueue_poll(&ref);
+			b = priqueue_poll(q);
+			n--;
+		}
+		else if (op < 8)
+		{
+			int index = rand() % n;
+			a = priqueue_at(&ref, index);
+			b = priqueue_at(q, index);
+		}
+		else if (op < 9)
+		{
+			int index = rand() % n;
+			a = priqueue_remove_at(&ref, index);
+			b = priqueue_remove_at(q, index);
+			n--;
+		}
+		else
+		{
+			int *ptr = priqueue_at(&ref, rand() % n);
+
+			if (rand() % 2)
+			{
+				a = priqueue_remove_handle(&ref, ref_handles[ptr - values]);
+				b = priqueue_remove_handle(q, handles[ptr - values]);
+			}
+			else if (priqueue_remove(&ref, ptr) != 1 || priqueue_remove(q, ptr) != 1)
+				failures++;
+			n--;
+		}
+
+		if (a != b || priqueue_size(q) != n || priqueue_peek(q) != priqueue_peek(&ref))
+			failures++;
+	}
+
+	priqueue_destroy(&ref);
+	priqueue_destroy(q);
+	free(values);
+	free(ref_handles);
+	free(handles);
+
+	return failures;
+}
+
+int cross_check(priqueue_backend_t backend, int ops)
+{
+	priqueue_t q;
+
+	priqueue_init_backend(&q, compare1, backend);
+
+	return cross_check_queue(&q, ops);
+}
+
+/* Changes keys of queued elements of q, an empty queue ordered by compare1,
+   through their handles and checks that it stays in order. Destroys q. */
+int update_check_queue(priqueue_t *q, int count, int ops)
+{
+	priqueue_handle_t *handles = malloc(count * sizeof(priqueue_handle_t));
+	int *values = malloc(count * sizeof(int));
+	int i, j, failures = 0;
+
+	srand(42);
+
+	for (i = 0; i < count; i++)
+	{
+		values[i] = rand() % 1000;
+		priqueue_offer_handle(q, &values[i], &handles[i]);
+	}
+
+	for (i = 0; i < ops; i++)
+	{
+		int k = rand() % count;
+		values[k] = rand() % 1000;
+		priqueue_update(q, handles[k]);
+
+		for (j = 1; j < count; j++)
+			if (*(int *)priqueue_at(q, j - 1) > *(int *)priqueue_at(q, j))
+				failures++;
+	}
+
+	priqueue_destroy(q);
+	free(values);
+	free(handles);
+
+	return failures;
+}
+
+int update_check(priqueue_backend_t backend, int count, int ops)
+{
+	priqueue_t q;
+
+	priqueue_init_backend(&q, compare1, backend);
+
+	return update_check_queue(&q, count, ops);
+}
+
+/* Checks the operation counters against the queue they describe. Without
+   make STATS=1 there are none, and priqueue_stats must zero them. */
+int stats_check(priqueue_backend_t backend, int ops)
+{
+	priqueue_t q;
+	priqueue_stats_t stats;
+	int *values = malloc(ops * sizeof(int));
+	int i, n = 0, peak = 0, failures = 0;
+
+	priqueue_init_backend(&q, compare1, backend);
+	srand(2017);
+
+	for (i = 0; i < ops; i++)
+	{
+		if (rand() % 3 < 2 || n == 0)
+		{
+			values[i] = rand() % 50;
+			priqueue_offer(&q, &values[i]);
+			n++;
+		}
+		else if (rand() % 2)
+		{
+			priqueue_poll(&q);
+			n--;
+		}
+		else
+		{
+			priqueue_remove_at(&q, rand() % n);
+			n--;
+		}
+
+		if (n > peak)
+			peak = n;
+	}
+
+	if (priqueue_stats(&q, &stats))
+	{
+		if (stats.size != n || stats.peak_size != peak || (int) (stats.allocs - stats.frees) != n)
+			failures++;
+		if (stats.calls[PRIQUEUE_OP_OFFER] + stats.calls[PRIQUEUE_OP_POLL] + stats.calls[PRIQUEUE_OP_REMOVE_AT] != (unsigned long) ops)
+			failures++;
+		if (stats.comparisons == 0)
+			failures++;
+	}
+	else
+	{
+		if (stats.size != 0 || stats.peak_size != 0 || stats.allocs != 0 || stats.comparisons != 0)
+			failures++;
+	}
+
+	priqueue_destroy(&q);
+	free(values);
+
+	return failures;
+}
+
+/* Takes from both ends of a queue on the given backend and checks every
+   step against the list's first and last elements. */
+int max_check(priqueue_backend_t backend, int ops)
+{
+	priqueue_t ref, q;
+	int *values = malloc(ops * sizeof(int));
+	priqueue_handle_t *ref_handles = malloc(ops * sizeof(priqueue_handle_t));
+	priqueue_handle_t *handles = malloc(ops * sizeof(priqueue_handle_t));
+	int i, n = 0, failures = 0;
+
+	priqueue_init(&ref, compare1);
+	priqueue_init_backend(&q, compare1, backend);
+	srand(2015);
+
+	for (i = 0; i < ops; i++)
+	{
+		int op = rand() % 8;
+		void *a = NULL, *b = NULL;
+
+		if (op < 4 || n == 0)
+		{
+			values[i] = rand() % 50;
+			priqueue_offer_handle(&ref, &values[i], &ref_handles[i]);
+			priqueue_offer_handle(&q, &values[i], &handles[i]);
+			n++;
+		}
+		else if (op < 5)
+		{
+			a = priqueue_poll(&ref);
+			b = priqueue_poll(&q);
+			n--;
+		}
+		else if (op < 7)
+		{
+			a = priqueue_remove_at(&ref, n - 1);
+			b = priqueue_poll_max(&q);
+			n--;
+		}
+		else
+		{
+			int *ptr = priqueue_at(&ref, rand() % n);
+			a = priqueue_remove_handle(&ref, ref_handles[ptr - values]);
+			b = priqueue_remove_handle(&q, handles[ptr - values]);
+			n--;
+		}
+
+		if (a != b || priqueue_size(&q) != n || priqueue_peek(&q) != priqueue_peek(&ref) ||
+		    priqueue_peek_max(&q) != priqueue_at(&ref, n - 1))
+			failures++;
+	}
+
+	if (priqueue_poll_max(&q) != priqueue_at(&ref, n - 1))
+		failures++;
+
+	priqueue_destroy(&ref);
+	priqueue_destroy(&q);
+	free(values);
+	free(ref_handles);
+	free(handles);
+
+	return failures;
+}
+
+/* Offers batches of several sizes into a partly filled queue and drains it
+   with priqueue_poll_n, checking the order (ties included) against
+   one-by-one offers into a list. */
+int batch_check(priqueue_backend_t backend)
+{
+	int sizes[4] = { 1, 10, 100, 1000 };
+	priqueue_t ref, q;
+	int *values = malloc(1001 * sizeof(int));
+	void **ptrs = malloc(1001 * sizeof(void *));
+	void *out[7];
+	int i, j, k, failures = 0;
+
+	srand(1234);
+
+	for (k = 0; k < 4; k++)
+	{
+		priqueue_init(&ref, compare1);
+		priqueue_init_backend(&q, compare1, backend);
+
+		// sizes[3 - k] one by one, then sizes[k] as a batch
+		int before = sizes[3 - k], batch = sizes[k];
+
+		for (i = 0; i < before + batch; i++)
+		{
+			values[i] = rand() % 50;
+			ptrs[i] = &values[i];
+			priqueue_offer(&ref, ptrs[i]);
+		}
+
+		for (i = 0; i < before; i++)
+			priqueue_offer(&q, ptrs[i]);
+		if (priqueue_offer_batch(&q, ptrs + before, batch) != batch)
+			failures++;
+
+		while (priqueue_size(&ref) > 0)
+		{
+			int polled = priqueue_poll_n(&q, out, 7);
+
+			for (j = 0; j < polled; j++)
+				if (out[j] != priqueue_poll(&ref))
+					failures++;
+			if (polled < 7 && priqueue_size(&ref) > 0)
+				failures++;
+		}
+
+		if (priqueue_size(&q) != 0 || priqueue_poll_n(&q, out, 7) != 0)
+			failures++;
+
+		priqueue_destroy(&ref);
+		priqueue_destroy(&q);
+	}
+
+	free(values);
+	free(ptrs);
+
+	return failures;
+}
+
+/* Walks an empty queue q, ordered by compare1, with a cursor, removing
+   every third element on the way, and checks the walk and what is left
+   against priqueue_at. Destroys q. */
+int iter_check_queue(priqueue_t *q, int count)
+{
+	priqueue_iter_t it;
+	int *values = malloc(count * sizeof(int));
+	void **expected = malloc(count * sizeof(void *));
+	void *ptr;
+	int i, n = 0, failures = 0;
+
+	srand(99);
+
+	for (i = 0; i < count; i++)
+	{
+		values[i] = rand() % 50;
+		priqueue_offer(q, &values[i]);
+	}
+
+	for (i = 0; i < count; i++)
+		expected[i] = priqueue_at(q, i);
+
+	for (ptr = priqueue_iter_begin(q, &it), i = 0; ptr != NULL; ptr = priqueue_iter_next(&it), i++)
+	{
+		if (ptr != expected[i])
+			failures++;
+
+		if (i % 3 == 0)
+		{
+			if (priqueue_iter_remove_current(&it) != ptr)
+				failures++;
+		}
+		else
+			expected[n++] = ptr;
+	}
+	priqueue_iter_end(&it);
+
+	if (i != count || priqueue_size(q) != n)
+		failures++;
+
+	for (i = 0; i < n; i++)
+		if (priqueue_at(q, i) != expected[i])
+			failures++;
+
+	priqueue_destroy(q);
+	free(values);
+	free(expected);
+
+	return failures;
+}
+
+int iter_check(priqueue_backend_t backend, int count)
+{
+	priqueue_t q;
+
+	priqueue_init_backend(&q, compare1, backend);
+
+	return iter_check_queue(&q, count);
+}
+
+int is_even(const void *ptr, void *arg)
+{
+	return *(const int *)ptr % 2 == 0;
+}
+
+/* Merges three batches of values into a, offering each to the emptied b
+   and removing one value of it from a through priqueue_remove afterwards,
+   then splits the even values out of a. Each half must poll its values in
+   the order the whole had them; which of several equal values from
+   different batches comes first is unspecified. Destroys a and b. */
+int merge_check_queues(priqueue_t *a, priqueue_t *b, int count)
+{
+	enum { ROUNDS = 3 };
+	priqueue_t evens;
+	int *values = malloc((ROUNDS + 1) * count * sizeof(int));
+	int *seen = calloc((ROUNDS + 1) * count, sizeof(int));
+	void **order = malloc((ROUNDS + 1) * count * sizeof(void *));
+	priqueue_iter_t it;
+	int *ptr;
+	int i, r, n = 0, total = count, evens_expected = 0, failures = 0;
+
+	srand(2020);
+
+	for (n = 0; n < count; n++)
+	{
+		values[n] = rand() % 50;
+		priqueue_offer(a, &values[n]);
+	}
+
+	for (r = 0; r < ROUNDS; r++)
+	{
+		for (i = 0; i < count; i++, n++)
+		{
+			values[n] = rand() % 50;
+			priqueue_offer(b, &values[n]);
+		}
+
+		if (priqueue_merge(a, b) != count || priqueue_remove(a, &values[n - 1]) != 1)
+			failures++;
+		seen[n - 1] = 1;
+		total += count - 1;
+
+		if (priqueue_size(a) != total || priqueue_size(b) != 0 || priqueue_peek(b) != NULL)
+			failures++;
+	}
+
+	for (ptr = priqueue_iter_begin(a, &it), i = 0; ptr != NULL; ptr = priqueue_iter_next(&it), i++)
+	{
+		order[i] = ptr;
+		if (*ptr % 2 == 0)
+			evens_expected++;
+	}
+	priqueue_iter_end(&it);
+
+	if (i != total || priqueue_split(a, &evens, is_even, NULL) != evens_expected)
+		failures++;
+
+	for (i = 0; i < total; i++)
+	{
+		int value = *(int *)order[i];
+
+		ptr = priqueue_poll(value % 2 == 0 ? &evens : a);
+		if (ptr == NULL || *ptr != value || seen[ptr - values]++)
+			failures++;
+	}
+
+	if (priqueue_size(a) != 0 || priqueue_size(&evens) != 0)
+		failures++;
+
+	priqueue_destroy(a);
+	priqueue_destroy(b);
+	priqueue_destroy(&evens);
+	free(values);
+	free(seen);
+	free(order);
+
+	return failures;
+}
+
+/* Merges a queue whose elements were all polled into an empty one and,
+   where the merge hands the nodes' memory over, checks that the merged
+   queue reuses the freed nodes instead of allocating more. */
+int merge_reuse_check(priqueue_backend_t backend, int count)
+{
+	priqueue_t a, b;
+	int *values = malloc(count * sizeof(int));
+	int i, live, slabs, b_slabs, failures = 0;
+
+	priqueue_init_backend(&a, compare1, backend);
+	priqueue_init_backend(&b, compare1, backend);
+
+	for (i = 0; i < count; i++)
+	{
+		values[i] = i;
+		priqueue_offer(&b, &values[i]);
+	}
+	while (priqueue_poll(&b) != NULL)
+		;
+
+	priqueue_pool_usage(&b, &live, &b_slabs);
+	priqueue_merge(&a, &b);
+	priqueue_pool_usage(&a, &live, &slabs);
+
+	if (slabs == b_slabs && b_slabs > 0)
+	{
+		for (i = 0; i < count; i++)
+			priqueue_offer(&a, &values[i]);
+
+		priqueue_pool_usage(&a, &live, &slabs);
+		if (slabs != b_slabs)
+			failures++;
+	}
+
+	priqueue_destroy(&a);
+	priqueue_destroy(&b);
+	free(values);
+
+	return failures;
+}
+
+int merge_check(priqueue_backend_t backend, int count)
+{
+	priqueue_t a, b;
+
+	priqueue_init_backend(&a, compare1, backend);
+	priqueue_init_backend(&b, compare1, backend);
+
+	return merge_check_queues(&a, &b, count) + merge_reuse_check(backend, count);
+}
+
+/* Offers keys no smaller than the last one polled, as an event queue does,
+   to a radix heap and checks polls, peeks and removals through handles
+   against the list backend. */
+int radix_check(int ops)
+{
+	priqueue_t ref, q;
+	int *values = malloc(ops * sizeof(int));
+	priqueue_handle_t *ref_handles = malloc(ops * sizeof(priqueue_handle_t));
+	priqueue_handle_t *handles = malloc(ops * sizeof(priqueue_handle_t));
+	int i, n = 0, last = -1000, failures = 0;
+
+	priqueue_init(&ref, compare1);
+	priqueue_init_radix(&q, int_key64);
+	srand(2718);
+
+	for (i = 0; i < ops; i++)
+	{
+		int op = rand() % 10;
+		void *a = NULL, *b = NULL;
+
+		if (op < 5 || n == 0)
+		{
+			values[i] = last + rand() % 300;
+			priqueue_offer_handle(&ref, &values[i], &ref_handles[i]);
+			priqueue_offer_handle(&q, &values[i], &handles[i]);
+			n++;
+		}
+		else if (op < 9)
+		{
+			a = priqueue_poll(&ref);
+			b = priqueue_poll(&q);
+			last = *(int *)a;
+			n--;
+		}
+		else
+		{
+			int *ptr = priqueue_at(&ref, rand() % n);
+
+			a = priqueue_remove_handle(&ref, ref_handles[ptr - values]);
+			b = priqueue_remove_handle(&q, handles[ptr - values]);
+			n--;
+		}
+
+		if (a != b || priqueue_size(&q) != n || priqueue_peek(&q) != priqueue_peek(&ref))
+			failures++;
+	}
+
+	priqueue_destroy(&ref);
+	priqueue_destroy(&q);
+	free(values);
+	free(ref_handles);
+	free(handles);
+
+	return failures;
+}
+
+/* Offers elements under explicit keys that reverse their values, re-keys
+   one through its handle and prints the poll order. */
+void keyed_check()
+{
+	priqueue_t q;
+	priqueue_handle_t handles[5];
+	int values[5] = { 0, 1, 2, 3, 4 };
+	int i;
+
+	priqueue_init_keyed(&q, NULL);
+
+	for (i = 0; i < 5; i++)
+		priqueue_offer_keyed(&q, &values[i], 10 - i, &handles[i]);
+	priqueue_rekey(&q, handles[1], 20);
+	priqueue_rekey(&q, handles[3], 6);
+
+	printf("Explicit keys (expected 3 4 2 0 1): ");
+	while (priqueue_size(&q) > 0)
+		printf("%d ", *(int *)priqueue_poll(&q));
+	printf("\n");
+
+	priqueue_destroy(&q);
+}
+
+typedef struct _item_t
+{
+	int value;
+	struct pq_node node;
+} item_t;
+
+/* Queues items through their embedded nodes; nothing should be allocated. */
+void intrusive_check()
+{
+	priqueue_t q;
+	priqueue_handle_t handle;
+	item_t items[5];
+	int start[5] = { 30, 10, 20, 10, 40 };
+	int i, live, slabs;
+
+	for (i = 0; i < 5; i++)
+	{
+		items[i].value = start[i];
+		pq_node_init(&items[i].node);
+	}
+
+	priqueue_init_intrusive(&q, compare1, offsetof(item_t, node));
+
+	for (i = 0; i < 4; i++)
+		priqueue_offer(&q, &items[i]);
+	priqueue_offer_handle(&q, &items[4], &handle);
+
+	priqueue_remove(&q, &items[2]);
+	items[4].value = 5;
+	priqueue_update(&q, handle);
+
+	printf("Removes of an element no longer queued (expected 0): %d\n", priqueue_remove(&q, &items[2]));
+
+	printf("Intrusive queue (expected 5 10 10 30): ");
+	for (i = 0; i < priqueue_size(&q); i++)
+		printf("%d ", ((item_t *)priqueue_at(&q, i))->value);
+	printf("\n");
+
+	printf("Intrusive poll order (expected items 4 1 3 0): ");
+	while (priqueue_size(&q) > 0)
+		printf("%d ", (int)((item_t *)priqueue_poll(&q) - items));
+	printf("\n");
+
+	priqueue_pool_usage(&q, &live, &slabs);
+	printf("Intrusive pool slabs: %d (expected 0).\n", slabs);
+
+	priqueue_destroy(&q);
+}
+
+typedef struct _stress_t
+{
+	priqueue_t *q;
+	int *values;
+	int count;
+	int *polled;
+} stress_t;
+
+/* Offers its own values, polling after every second offer, and records
+   every value it polls. */
+void *stress_thread(void *arg)
+{
+	stress_t *s = arg;
+	int i, *value;
+
+	for (i = 0; i < s->count; i++)
+	{
+		priqueue_offer(s->q, &s->values[i]);
+
+		if (i % 2 == 1 && (value = priqueue_poll(s->q)) != NULL)
+			s->polled[*value]++;
+	}
+
+	return NULL;
+}
+
+/* Forks persistent queues at random points and changes the versions
+   independently, alongside list copies made by priqueue_clone's
+   element-by-element fallback; every version must match its copy. Some
+   versions are destroyed and forked again, so the ones left must not
+   depend on their originals. */
+int clone_check(int ops)
+{
+	enum { VERSIONS = 8 };
+	priqueue_t pers[VERSIONS], refs[VERSIONS];
+	int *values = malloc(ops * sizeof(int));
+	priqueue_handle_t *handles = malloc(ops * sizeof(priqueue_handle_t));
+	int i, v, count = 1, failures = 0;
+	void *a, *b;
+
+	priqueue_init_persistent(&pers[0], compare1);
+	priqueue_init(&refs[0], compare1);
+	srand(2019);
+
+	for (i = 0; i < ops; i++)
+	{
+		int op = rand() % 10;
+		int n;
+
+		v = rand() % count;
+		n = priqueue_size(&refs[v]);
+		a = b = NULL;
+
+		if (op < 5 || n == 0)
+		{
+			values[i] = rand() % 50;
+			priqueue_offer_handle(&pers[v], &values[i], &handles[i]);
+			priqueue_offer(&refs[v], &values[i]);
+		}
+		else if (op < 6)
+		{
+			a = priqueue_poll(&refs[v]);
+			b = priqueue_poll(&pers[v]);
+		}
+		else if (op < 7)
+		{
+			int index = rand() % n;
+			a = priqueue_remove_at(&refs[v], index);
+			b = priqueue_remove_at(&pers[v], index);
+		}
+		else if (op < 8)
+		{
+			int *ptr = priqueue_at(&refs[v], rand() % n);
+			a = ptr;
+			b = priqueue_remove_handle(&pers[v], handles[ptr - values]);
+			priqueue_remove(&refs[v], ptr);
+		}
+		else if (op < 9 && count < VERSIONS)
+		{
+			if (priqueue_clone(&pers[count], &pers[v]) != 0 || priqueue_clone(&refs[count], &refs[v]) != 0)
+				failures++;
+			count++;
+		}
+		else if (count > 1)
+		{
+			int w = (v + 1 + rand() % (count - 1)) % count;
+
+			priqueue_destroy(&pers[v]);
+			priqueue_destroy(&refs[v]);
+			if (priqueue_clone(&pers[v], &pers[w]) != 0 || priqueue_clone(&refs[v], &refs[w]) != 0)
+				failures++;
+		}
+
+		if (a != b || priqueue_size(&pers[v]) != priqueue_size(&refs[v]) || priqueue_peek(&pers[v]) != priqueue_peek(&refs[v]))
+			failures++;
+	}
+
+	for (v = 0; v < count; v++)
+	{
+		do
+		{
+			a = priqueue_poll(&refs[v]);
+			b = priqueue_poll(&pers[v]);
+			if (a != b)
+				failures++;
+		} while (a != NULL);
+
+		priqueue_destroy(&pers[v]);
+		priqueue_destroy(&refs[v]);
+	}
+
+	free(values);
+	free(handles);
+
+	return failures;
+}
+
+/* Several threads offer and poll one concurrent queue, made with the given
+   flags, at once; afterwards every value must have been polled exactly
+   once. */
+int concurrent_check(int threads, int count, int flags)
+{
+	priqueue_t q;
+	pthread_t tid[threads];
+	stress_t work[threads];
+	int *values = malloc(threads * count * sizeof(int));
+	int *polled = calloc(threads * count, sizeof(int));
+	int i, failures = 0, *value;
+
+	priqueue_concurrent_init_flags(&q, compare1, flags);
+
+	for (i = 0; i < threads * count; i++)
+		values[i] = i;
+
+	for (i = 0; i < threads; i++)
+	{
+		work[i].q = &q;
+		work[i].values = values + i * count;
+		work[i].count = count;
+		work[i].polled = calloc(threads * count, sizeof(int));
+		pthread_create(&tid[i], NULL, stress_thread, &work[i]);
+	}
+
+	for (i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+
+	// drain what is left; unless relaxed, it must come out sorted
+	int last = -1;
+	while ((value = priqueue_poll(&q)) != NULL)
+	{
+		if (*value < last && !(flags & PRIQUEUE_RELAXED))
+			failures++;
+		last = *value;
+		polled[*value]++;
+	}
+
+	for (i = 0; i < threads * count; i++)
+	{
+		int t, total = polled[i];
+
+		for (t = 0; t < threads; t++)
+			total += work[t].polled[i];
+		if (total != 1)
+			failures++;
+	}
+
+	if (priqueue_size(&q) != 0)
+		failures++;
+
+	for (i = 0; i < threads; i++)
+		free(work[i].polled);
+	priqueue_destroy(&q);
+	free(values);
+	free(polled);
+
+	return failures;
+}
+
+int main()
+{
+	priqueue_t q, q2;
+	int i;
+
+	for (i = 0; i < PRIQUEUE_NUM_BACKENDS; i++)
+	{
+		run_tests((priqueue_backend_t) i);
+		printf("Random cross-check against list: %d mismatches (expected 0).\n", cross_check((priqueue_backend_t) i, 2000));
+		printf("Keys changed through handles: %d out of order (expected 0).\n", update_check((priqueue_backend_t) i, 100, 500));
+		printf("Cursor walk with removals: %d mismatches (expected 0).\n", iter_check((priqueue_backend_t) i, 300));
+		printf("Batch offer and poll_n: %d mismatches (expected 0).\n", batch_check((priqueue_backend_t) i));
+		printf("Polls from both ends: %d mismatches (expected 0).\n", max_check((priqueue_backend_t) i, 3000));
+		printf("Operation counters: %d inconsistencies (expected 0).\n", stats_check((priqueue_backend_t) i, 1000));
+		printf("Merges and a split: %d mismatches (expected 0).\n", merge_check((priqueue_backend_t) i, 200));
+		printf("\n");
+	}
+
+	// keys outside the bucket range share the end buckets
+	printf("== Bucket queue ==\n");
+	priqueue_init_bucket(&q, compare1, int_key, 10, 39);
+	printf("Random cross-check against list: %d mismatches (expected 0).\n", cross_check_queue(&q, 2000));
+	priqueue_init_bucket(&q, compare1, int_key, 0, 255);
+	printf("Keys changed through handles: %d out of order (expected 0).\n", update_check_queue(&q, 100, 500));
+	priqueue_init_bucket(&q, compare1, int_key, 0, 49);
+	printf("Cursor walk with removals: %d mismatches (expected 0).\n", iter_check_queue(&q, 300));
+
+	printf("\n== Radix heap ==\n");
+	printf("Monotone cross-check against list: %d mismatches (expected 0).\n", radix_check(5000));
+	priqueue_init_radix(&q, int_key64);
+	printf("Cursor walk with removals: %d mismatches (expected 0).\n", iter_check_queue(&q, 300));
+
+	printf("\n== Key-cached heap ==\n");
+	priqueue_init_keyed(&q, int_key64);
+	printf("Random cross-check against list: %d mismatches (expected 0).\n", cross_check_queue(&q, 2000));
+	priqueue_init_keyed(&q, int_key64);
+	printf("Keys changed through handles: %d out of order (expected 0).\n", update_check_queue(&q, 100, 500));
+	priqueue_init_keyed(&q, int_key64);
+	printf("Cursor walk with removals: %d mismatches (expected 0).\n", iter_check_queue(&q, 300));
+	keyed_check();
+
+	printf("\n== Persistent heap ==\n");
+	priqueue_init_persistent(&q, compare1);
+	printf("Random cross-check against list: %d mismatches (expected 0).\n", cross_check_queue(&q, 2000));
+	priqueue_init_persistent(&q, compare1);
+	printf("Keys changed through handles: %d out of order (expected 0).\n", update_check_queue(&q, 100, 500));
+	priqueue_init_persistent(&q, compare1);
+	printf("Cursor walk with removals: %d mismatches (expected 0).\n", iter_check_queue(&q, 300));
+	printf("Clones changed independently: %d mismatches (expected 0).\n", clone_check(5000));
+	priqueue_init_persistent(&q, compare1);
+	priqueue_init_persistent(&q2, compare1);
+	printf("Merges and a split: %d mismatches (expected 0).\n", merge_check_queues(&q, &q2, 200));
+
+	printf("\n== Intrusive tree ==\n");
+	intrusive_check();
+
+	printf("\n== Concurrent skiplist ==\n");
+	priqueue_concurrent_init(&q, compare1);
+	printf("Random cross-check against list: %d mismatches (expected 0).\n", cross_check_queue(&q, 2000));
+	priqueue_concurrent_init(&q, compare1);
+	printf("Keys changed through handles: %d out of order (expected 0).\n", update_check_queue(&q, 100, 500));
+	printf("Four threads offering and polling: %d lost or duplicated (expected 0).\n", concurrent_check(4, 20000, 0));
+
+	// one shard is exact, so it can be checked against the list
+	printf("\n== Relaxed MultiQueue ==\n");
+	priqueue_concurrent_init_flags(&q, compare1, PRIQUEUE_RELAXED | PRIQUEUE_SHARDS(1));
+	printf("Random cross-check against list: %d mismatches (expected 0).\n", cross_check_queue(&q, 2000));
+	priqueue_concurrent_init_flags(&q, compare1, PRIQUEUE_RELAXED | PRIQUEUE_SHARDS(4));
+	printf("Keys changed through handles: %d out of order (expected 0).\n", update_check_queue(&q, 100, 500));
+	printf("Four threads offering and polling: %d lost or duplicated (expected 0).\n", concurrent_check(4, 20000, PRIQUEUE_RELAXED | PRIQUEUE_SHARDS(8)));
 
 	return 0;
 }
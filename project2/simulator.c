@@ -15,10 +15,20 @@ typedef struct _simulator_job_list_t
 
 void print_usage(char *program_name)
 {
-	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> <input file>\n", program_name);
+	int i;
+
+	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> [-q <queue>] [-e] <input file>\n", program_name);
 	fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#\n");
+	fprintf(stderr, "Acceptable queues are:");
+	for (i = 0; i < PRIQUEUE_NUM_BACKENDS; i++)
+		fprintf(stderr, "%s %s", i ? "," : "", priqueue_backend_name((priqueue_backend_t) i));
+	fprintf(stderr, "\n");
+	fprintf(stderr, "By default fcfs queues jobs in a bucket queue, as do pri and ppri unless the\n");
+	fprintf(stderr, "priorities span more than %d values (then tree); sjf and psjf use a keyed heap\n", SCHEDULER_PRIORITY_BUCKETS);
+	fprintf(stderr, "and rr# a ring buffer.\n");
+	fprintf(stderr, "-e skips from event to event instead of stepping every time unit\n");
 }
 
 int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int active_jobs)
@@ -59,6 +69,60 @@ void print_available_jobs(simulator_job_list_t *jobs, int active_jobs)
 		printf("\n");
 }
 
+/* Writes the timing diagram symbol for a job: 0-9, a-z, A-Z, then (id).
+   out must hold 13 characters. */
+void job_symbol(char *out, int job_id)
+{
+	if (job_id < 10)
+		sprintf(out, "%d", job_id);
+	else if (job_id < 10 + 26)
+		sprintf(out, "%c", job_id - 10 + 'a');
+	else if (job_id < 10 + 26 + 26)
+		sprintf(out, "%c", job_id - 10 - 26 + 'A');
+	else
+		snprintf(out, 13, "(%d)", job_id);
+}
+
+/* Prints the job queue's operation counters, when the library keeps them
+   (make STATS=1), ahead of the final results so those stay the last lines
+   of the output. */
+void print_queue_stats()
+{
+	priqueue_stats_t stats;
+	int i;
+
+	if (!scheduler_queue_stats(&stats))
+		return;
+
+	printf("Queue Comparisons: %lu\n", stats.comparisons);
+	printf("Queue Node Hops: %lu\n", stats.hops);
+	printf("Queue Allocations: %lu (%lu freed)\n", stats.allocs, stats.frees);
+	printf("Queue Peak Size: %d\n", stats.peak_size);
+	printf("Queue Calls:");
+	for (i = 0; i < PRIQUEUE_NUM_OPS; i++)
+	{
+		if (stats.calls[i] > 0)
+			printf(" %s %lu", priqueue_op_name((priqueue_op_t) i), stats.calls[i]);
+	}
+	printf("\n\n");
+}
+
+void print_results(char **core_timing_diagram, int cores)
+{
+	int i;
+
+	print_queue_stats();
+
+	printf("FINAL TIMING DIAGRAM:\n");
+	for (i = 0; i < cores; i++)
+		printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+
+	printf("\n");
+	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
+	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
+	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+}
+
 void print_available_cores(int cores)
 {
 	printf("Active cores are: ");
@@ -74,16 +138,333 @@ void print_available_cores(int cores)
 }
 
 
+/*
+ * Event-driven mode (-e). Instead of stepping through every time unit, the
+ * simulation jumps straight to the next job arrival, job completion or
+ * quantum expiry. Events wait in a radix heap ordered as the step-by-step
+ * loop would meet them: by time, then completions before quantum expiries
+ * before arrivals, then completions and arrivals by the job's place in
+ * that loop's job table and expiries by core. The table is mirrored in
+ * order and position, including how a finished job is replaced by the
+ * last one, so both modes produce the same schedule. Pending completions
+ * and expiries are cancelled through their handles when a job is
+ * preempted. A job moved into a finished job's place takes the place being
+ * polled, so no key ever drops below the last one polled.
+ */
+typedef enum { EVENT_FINISH = 0, EVENT_QUANTUM, EVENT_ARRIVAL } event_kind_t;
+
+typedef struct _simulator_event_t
+{
+	int time, kind;
+	int id;  // the job, or for EVENT_QUANTUM the core
+	int queued;
+	unsigned long long key;
+	priqueue_handle_t handle;
+} simulator_event_t;
+
+typedef struct _simulator_events_t
+{
+	priqueue_t queue;
+	simulator_event_t *arrival, *finish, *expire;
+	int *running, *since;
+	int *order, *position;  // the step-by-step job table: job at each place, place of each job
+	int active, slots;
+	char **diagram;
+	int *diagram_size;
+	int cores, quantum, time;
+} simulator_events_t;
+
+/* The queue key of e at place slot: the job's place in the table, or the
+   core for an expiry. */
+unsigned long long event_key(simulator_events_t *ev, simulator_event_t *e, int slot)
+{
+	return ((unsigned long long) e->time * 3 + e->kind) * ev->slots + slot;
+}
+
+unsigned long long event_queue_key(const void *e)
+{
+	return ((const simulator_event_t *) e)->key;
+}
+
+void cancel_event(simulator_events_t *ev, simulator_event_t *e)
+{
+	if (e->queued)
+	{
+		priqueue_remove_handle(&ev->queue, e->handle);
+		e->queued = 0;
+	}
+}
+
+void schedule_event(simulator_events_t *ev, simulator_event_t *e, int time, int slot)
+{
+	cancel_event(ev, e);
+	e->time = time;
+	e->queued = 1;
+	e->key = event_key(ev, e, slot);
+	priqueue_offer_handle(&ev->queue, e, &e->handle);
+}
+
+/* Drops finished job j from the job table as the step-by-step loop does,
+   moving the last job into its place, and reorders that job's events. */
+void retire_job(simulator_events_t *ev, int j)
+{
+	int slot = ev->position[j];
+	int last = ev->order[--ev->active];
+
+	ev->order[slot] = last;
+	ev->position[last] = slot;
+
+	if (ev->finish[last].queued)
+	{
+		ev->finish[last].key = event_key(ev, &ev->finish[last], slot);
+		priqueue_update(&ev->queue, ev->finish[last].handle);
+	}
+	if (ev->arrival[last].queued)
+	{
+		ev->arrival[last].key = event_key(ev, &ev->arrival[last], slot);
+		priqueue_update(&ev->queue, ev->arrival[last].handle);
+	}
+}
+
+/* Takes whatever job is on core off it, charging it for the time it ran. */
+void stop_core(simulator_events_t *ev, simulator_job_list_t *jobs, int core)
+{
+	int j = ev->running[core];
+
+	if (j != -1)
+	{
+		jobs[j].run_time -= ev->time - ev->since[core];
+		jobs[j].core_id = -1;
+		cancel_event(ev, &ev->finish[j]);
+	}
+
+	ev->running[core] = -1;
+	cancel_event(ev, &ev->expire[core]);
+}
+
+void start_core(simulator_events_t *ev, simulator_job_list_t *jobs, int core, int j)
+{
+	ev->running[core] = j;
+	ev->since[core] = ev->time;
+	jobs[j].core_id = core;
+
+	schedule_event(ev, &ev->finish[j], ev->time + jobs[j].run_time, ev->position[j]);
+	if (ev->quantum > 0)
+		schedule_event(ev, &ev->expire[core], ev->time + ev->quantum, core);
+}
+
+/* Extends every core's timing diagram up to time. */
+int advance_time(simulator_events_t *ev, int time)
+{
+	char symbol[13];
+	int i, k;
+
+	for (i = 0; i < ev->cores; i++)
+	{
+		if (ev->running[i] == -1)
+			strcpy(symbol, "-");
+		else
+			job_symbol(symbol, ev->running[i]);
+
+		for (k = ev->time; k < time; k++)
+		{
+			while (strlen(ev->diagram[i]) + strlen(symbol) >= (unsigned int)ev->diagram_size[i])
+			{
+				char *diagram = realloc(ev->diagram[i], 2 * ev->diagram_size[i] + 1);
+
+				if (diagram == NULL)
+				{
+					fprintf(stderr, "Out of memory.\n");
+					return 0;
+				}
+
+				ev->diagram[i] = diagram;
+				ev->diagram_size[i] *= 2;
+			}
+
+			strcat(ev->diagram[i], symbol);
+		}
+	}
+
+	ev->time = time;
+
+	return 1;
+}
+
+/* Checks a job chosen by the scheduler and puts it on core. */
+int assign_job(simulator_events_t *ev, simulator_job_list_t *jobs, int num_jobs, int core, int j, const char *caller)
+{
+	if (j == -1)
+		return 1;
+
+	if (j == SCHEDULER_NO_MEMORY)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 0;
+	}
+
+	if (j < 0 || j >= num_jobs || !jobs[j].arrived || jobs[j].run_time == 0 || jobs[j].core_id != -1)
+	{
+		printf("The %s() selected an invalid job (job_id == %d).\n", caller, j);
+		return 0;
+	}
+
+	start_core(ev, jobs, core, j);
+
+	return 1;
+}
+
+int run_events(simulator_job_list_t *jobs, int num_jobs, int cores, int quantum)
+{
+	simulator_events_t ev;
+	simulator_event_t *e;
+	int i, status = 0, shown = -1;
+
+	priqueue_init_radix(&ev.queue, event_queue_key);
+	ev.arrival = calloc(num_jobs, sizeof(simulator_event_t));
+	ev.finish = calloc(num_jobs, sizeof(simulator_event_t));
+	ev.expire = calloc(cores, sizeof(simulator_event_t));
+	ev.running = malloc(cores * sizeof(int));
+	ev.since = malloc(cores * sizeof(int));
+	ev.diagram = malloc(cores * sizeof(char *));
+	ev.diagram_size = malloc(cores * sizeof(int));
+	ev.order = malloc(num_jobs * sizeof(int));
+	ev.position = malloc(num_jobs * sizeof(int));
+	ev.active = num_jobs;
+	ev.slots = num_jobs > cores ? num_jobs : cores;
+	ev.cores = cores;
+	ev.quantum = quantum;
+	ev.time = 0;
+
+	for (i = 0; i < cores; i++)
+	{
+		ev.running[i] = -1;
+		ev.expire[i].kind = EVENT_QUANTUM;
+		ev.expire[i].id = i;
+		ev.diagram_size[i] = 1024;
+		ev.diagram[i] = malloc(ev.diagram_size[i] + 1);
+		ev.diagram[i][0] = '\0';
+	}
+
+	for (i = 0; i < num_jobs; i++)
+	{
+		ev.finish[i].kind = EVENT_FINISH;
+		ev.finish[i].id = i;
+		ev.arrival[i].kind = EVENT_ARRIVAL;
+		ev.arrival[i].id = i;
+		ev.order[i] = ev.position[i] = i;
+		schedule_event(&ev, &ev.arrival[i], jobs[i].arrival_time, i);
+	}
+
+	while (status == 0 && (e = priqueue_poll(&ev.queue)) != NULL)
+	{
+		int j, core, new_id;
+
+		e->queued = 0;
+
+		if (e->time != shown)
+		{
+			if (!advance_time(&ev, e->time))
+			{
+				status = 3;
+				break;
+			}
+			printf("=== [TIME %d] ===\n", ev.time);
+			shown = ev.time;
+		}
+
+		switch (e->kind)
+		{
+			case EVENT_FINISH:
+				j = e->id;
+				core = jobs[j].core_id;
+				stop_core(&ev, jobs, core);
+				retire_job(&ev, j);
+
+				new_id = scheduler_job_finished(core, j, ev.time);
+				if (!assign_job(&ev, jobs, num_jobs, core, new_id, "scheduler_job_finished"))
+					status = 3;
+				else
+					printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", j, core, core, new_id);
+				break;
+
+			case EVENT_QUANTUM:
+				core = e->id;
+				j = ev.running[core];
+				stop_core(&ev, jobs, core);
+
+				new_id = scheduler_quantum_expired(core, ev.time);
+				if (!assign_job(&ev, jobs, num_jobs, core, new_id, "scheduler_quantum_expired"))
+					status = 3;
+				else
+					printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", j, core, core, new_id);
+				break;
+
+			case EVENT_ARRIVAL:
+				j = e->id;
+				jobs[j].arrived = 1;
+
+				core = scheduler_new_job(j, ev.time, jobs[j].run_time, jobs[j].priority);
+				if (core >= 0 && core < cores)
+				{
+					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
+							j, jobs[j].run_time, jobs[j].priority, j, core);
+					stop_core(&ev, jobs, core);
+					start_core(&ev, jobs, core, j);
+				}
+				else if (core == -1)
+					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
+							j, jobs[j].run_time, jobs[j].priority, j);
+				else if (core == SCHEDULER_NO_MEMORY)
+				{
+					fprintf(stderr, "Out of memory.\n");
+					status = 3;
+				}
+				else
+				{
+					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", core);
+					print_available_cores(cores);
+					status = 3;
+				}
+				break;
+		}
+
+		if (status == 0)
+		{
+			printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
+		}
+	}
+
+	if (status == 0)
+		print_results(ev.diagram, cores);
+
+	priqueue_destroy(&ev.queue);
+	for (i = 0; i < cores; i++)
+		free(ev.diagram[i]);
+	free(ev.diagram);
+	free(ev.diagram_size);
+	free(ev.running);
+	free(ev.since);
+	free(ev.order);
+	free(ev.position);
+	free(ev.arrival);
+	free(ev.finish);
+	free(ev.expire);
+
+	return status;
+}
+
 int main(int argc, char **argv)
 {
 	int c;
-	int cores = 0, scheme = -1, quantum = 0;
+	int cores = 0, scheme = -1, quantum = 0, event_driven = 0;
+	priqueue_backend_t queue = PRIQUEUE_NUM_BACKENDS;
 	char *file_name;
 
 	/*
 	 * Parse command line options.
 	 */
-	while ((c = getopt(argc, argv, "c:s:")) != -1)
+	while ((c = getopt(argc, argv, "c:s:q:e")) != -1)
 	{
 		switch (c)
 		{
@@ -118,6 +499,21 @@ int main(int argc, char **argv)
 				}
 				break;
 
+			case 'q':
+				queue = priqueue_backend_lookup(optarg);
+
+				if (queue == PRIQUEUE_NUM_BACKENDS)
+				{
+					fprintf(stderr, "Option -q <queue> requires a known queue backend.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'e':
+				event_driven = 1;
+				break;
+
 			case '?':
 				print_usage(argv[0]);
 				return 1;
@@ -221,8 +617,34 @@ int main(int argc, char **argv)
 	else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
 	printf(" scheduling...\n\n");
 
+	if (queue != PRIQUEUE_NUM_BACKENDS)
+		scheduler_set_queue_backend(queue);
+
+	if (job_id > 0)
+	{
+		int lowest = jobs[0].priority, highest = jobs[0].priority, k;
+
+		for (k = 1; k < job_id; k++)
+		{
+			if (jobs[k].priority < lowest) lowest = jobs[k].priority;
+			if (jobs[k].priority > highest) highest = jobs[k].priority;
+		}
+
+		scheduler_set_priority_range(lowest, highest);
+	}
+
 	scheduler_start_up(cores, scheme);
 
+	if (event_driven)
+	{
+		int status = run_events(jobs, job_id, cores, quantum);
+
+		scheduler_clean_up();
+		free(jobs);
+
+		return status;
+	}
+
 
 	int time = 0, i, j;
 	int active_jobs = job_id, jobs_alive = 0;
@@ -303,6 +725,12 @@ int main(int argc, char **argv)
 							int old_job_id = jobs[j].job_id;
 							int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
 
+							if (new_job_id == SCHEDULER_NO_MEMORY)
+							{
+								fprintf(stderr, "Out of memory.\n");
+								return 3;
+							}
+
 							jobs[j].core_id = -1;
 
 							quantum_clock[core_id] = quantum;
@@ -362,6 +790,11 @@ int main(int argc, char **argv)
 							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id);
 					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
 				}
+				else if (new_job_core_id == SCHEDULER_NO_MEMORY)
+				{
+					fprintf(stderr, "Out of memory.\n");
+					return 3;
+				}
 				else
 				{
 					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
@@ -375,7 +808,7 @@ int main(int argc, char **argv)
 		/*
 		 * 4. Run the time unit.
 		 */
-		char time_string[cores][11];
+		char time_string[cores][13];
 		int cores_working = 0;
 
 		for (i = 0; i < cores; i++)
@@ -391,14 +824,7 @@ int main(int argc, char **argv)
 
 				assert(time_string[jobs[i].core_id][0] == '\0');
 
-				if (jobs[i].job_id < 10)
-					sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
-				else if (jobs[i].job_id < 10 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
-				else if (jobs[i].job_id < 10 + 26 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
-				else
-					snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
+				job_symbol(time_string[jobs[i].core_id], jobs[i].job_id);
 			}
 		}
 
@@ -465,14 +891,7 @@ int main(int argc, char **argv)
 	}
 
 
-	printf("FINAL TIMING DIAGRAM:\n");
-	for (i = 0; i < cores; i++)
-		printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
-
-	printf("\n");
-	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
-	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
-	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+	print_results(core_timing_diagram, cores);
 
 	scheduler_clean_up();
 
@@ -0,0 +1,114 @@
+/** @file templatebench.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libpriqueue/libpriqueue.h"
+#include "libscheduler/job.h"
+#include "libscheduler/jobqueue.h"
+
+/*
+ * Compares the function-pointer priqueue_t heap with the key-cached heap,
+ * which orders by SJF_KEY64 computed once per offer, and with the C++
+ * PriQueue specialized on SJF_COMPARE, reached through its C shim. Each
+ * run offers n jobs with random run times and then polls them all.
+ *
+ * Usage: templatebench [max elements]   (default 10000000)
+ */
+
+double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double run_priqueue(job_t *jobs, int n)
+{
+	priqueue_t q;
+	int i;
+
+	priqueue_init_backend(&q, SJF_COMPARE, PRIQUEUE_HEAP);
+
+	double start = now();
+	for (i = 0; i < n; i++)
+		priqueue_offer(&q, &jobs[i]);
+	for (i = 0; i < n; i++)
+		priqueue_poll(&q);
+	double elapsed = now() - start;
+
+	priqueue_destroy(&q);
+
+	return elapsed;
+}
+
+double run_keyed(job_t *jobs, int n)
+{
+	priqueue_t q;
+	int i;
+
+	priqueue_init_keyed(&q, SJF_KEY64);
+
+	double start = now();
+	for (i = 0; i < n; i++)
+		priqueue_offer(&q, &jobs[i]);
+	for (i = 0; i < n; i++)
+		priqueue_poll(&q);
+	double elapsed = now() - start;
+
+	priqueue_destroy(&q);
+
+	return elapsed;
+}
+
+double run_template(job_t *jobs, int n)
+{
+	sjf_queue_t *q = sjf_queue_create();
+	int i;
+
+	double start = now();
+	for (i = 0; i < n; i++)
+		sjf_queue_offer(q, &jobs[i]);
+	for (i = 0; i < n; i++)
+		sjf_queue_poll(q);
+	double elapsed = now() - start;
+
+	sjf_queue_destroy(q);
+
+	return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	int max = argc > 1 ? atoi(argv[1]) : 10000000;
+	int n, i;
+
+	printf("%10s %22s %22s %22s %8s\n", "elements", "priqueue_t (ns/op)", "key-cached (ns/op)", "PriQueue (ns/op)", "speedup");
+
+	for (n = 1000; n <= max; n *= 10)
+	{
+		job_t *jobs = malloc(n * sizeof(job_t));
+
+		srand(678);
+		for (i = 0; i < n; i++)
+		{
+			jobs[i].job_id = i;
+			jobs[i].arrival_time = i;
+			jobs[i].run_time = rand() % 1000 + 1;
+		}
+
+		// one offer and one poll per element
+		double fn = run_priqueue(jobs, n) / (2.0 * n) * 1e9;
+		double keyed = run_keyed(jobs, n) / (2.0 * n) * 1e9;
+		double tmpl = run_template(jobs, n) / (2.0 * n) * 1e9;
+
+		printf("%10d %22.1f %22.1f %22.1f %7.2fx\n", n, fn, keyed, tmpl, fn / tmpl);
+
+		free(jobs);
+	}
+
+	return 0;
+}